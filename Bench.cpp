@@ -0,0 +1,390 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "Game.h"
+#include "Digits.h"
+#include "Env.h"
+#include "Raster.h"
+
+using namespace std;
+
+/* Microbenchmarks of the simulation's hot paths, each run over entity counts from 10 to 1M */
+/* Every scenario is built from a fixed seed, so two runs measure the same work; results are written as JSON */
+
+/* A scenario sets up its state for n entities once, then runs the measured work repeatedly */
+struct Benchmark {
+	const char *name;
+	void (*setup) (int n);
+	long (*run) (int n);	// returns the number of items processed
+};
+typedef struct Benchmark Benchmark;
+
+const unsigned int BENCH_SEED = 1;
+
+/* Every scenario works on the same game, set up once by main */
+static GameInstance game;
+
+static float randomIn (float lo, float hi)
+{
+	return lo + (hi - lo) * (rand() / (float) RAND_MAX);
+}
+
+/* n bricks spread over the playfield, all still falling */
+static void fillBricks (int n)
+{
+	game.bricks.clear();
+	game.bricks.reserve(n);
+	for (int i = 0; i < n; i++)
+		game.bricks.add(randomIn(-390.0, 390.0), randomIn(-230.0, 300.0), 10.0, 20.0, rand() % NUM_BRICK_KINDS);
+}
+
+/* Brick update - one tick's fall of n bricks, with the bucket classification run on a fixed mix: a quarter of */
+/* the bricks cross the bucket line this pass, split between landing over the red bucket, over the blue one and */
+/* over neither; an eighth have already missed and are falling off screen; the rest are still falling above */
+const float BENCH_FALL = 5.0;
+static vector<float> savedy;
+static vector<int> savedfallactive;
+static void setupBrickUpdate (int n)
+{
+	srand(BENCH_SEED);
+	resetGame(game);
+	fillBricks(n);
+	BrickField &bricks = game.bricks;
+	for (int i = 0; i < n; i++){
+		if(i % 4 == 0){
+			// Within one fall of the line, and across it after this pass
+			const float overx[3] = {200.0, -200.0, 0.0};
+			bricks.x[i] = overx[rand() % 3] + randomIn(-40.0, 40.0);
+			bricks.y[i] = randomIn(-240.0 + BENCH_FALL * 0.1, -240.0 + BENCH_FALL * 0.9);
+		}
+		else if(i % 8 == 1){
+			bricks.y[i] = randomIn(-350.0, -350.0 + 2.0 * BENCH_FALL);
+			bricks.active[i] = 0;
+		}
+	}
+	savedy = bricks.y;
+	savedfallactive = bricks.active;
+}
+static volatile int fallsink;
+static long runBrickUpdate (int n)
+{
+	// Put every brick back where it started, so each pass classifies the same bricks
+	game.bricks.y = savedy;
+	game.bricks.active = savedfallactive;
+	int caught, blackcaught;
+	fallBricks(game.bricks, BENCH_FALL, game.buckets[game.redBucket], game.buckets[game.blueBucket], caught, blackcaught);
+	fallsink = caught + blackcaught;
+	return n;
+}
+
+/* Brick-beam collision - n bricks against one beam per 100 bricks, each sweeping a tick's worth of its path */
+static vector<int> savedactive;
+static void setupCollision (int n)
+{
+	srand(BENCH_SEED);
+	resetGame(game);
+	fillBricks(n);
+	savedactive = game.bricks.active;
+	int beams = n/100 > 0 ? n/100 : 1;
+	for (int i = 0; i < beams; i++){
+		Beam shot = Beam();
+		shot.height = 1.0;
+		shot.width = 30.0;
+		shot.objcolor = red;
+		shot.active = 1;
+		float angle = randomIn(-60.0, 60.0);
+		traceBeam(game, shot, randomIn(-300.0, 300.0), randomIn(-200.0, 200.0), angle, cos (angle * M_PI/180.0), sin (angle * M_PI/180.0));
+		game.beam.add(shot);
+	}
+}
+static long runCollision (int n)
+{
+	// Restore what the last pass destroyed, so every pass tests the same pairs
+	game.bricks.active = savedactive;
+	for (ObjectPool<Beam> :: iterator it = game.beam.begin(); it != game.beam.end(); it++){
+		it->active = 1;
+		it->prevtravelled = 0.0;
+		it->travelled = BEAM_SPEED;
+	}
+	collideBeams(game);
+	game.totalscore = 0;
+	game.life = 3;
+	game.gameover = 0;
+	return n;
+}
+
+/* Mirror reflection - tracing n beams from random points of the gun's travel through the mirrors */
+static vector<float> gunys, gunangles;
+static volatile long tracesink;
+static void setupReflection (int n)
+{
+	srand(BENCH_SEED);
+	resetGame(game);
+	gunys.resize(n);
+	gunangles.resize(n);
+	for (int i = 0; i < n; i++){
+		gunys[i] = randomIn(-150.0, 200.0);
+		gunangles[i] = 10.0 * (rand() % 13 - 6);
+	}
+}
+static long runReflection (int n)
+{
+	Beam shot;
+	long bounces = 0;
+	for (int i = 0; i < n; i++){
+		float dx = cos (gunangles[i] * M_PI/180.0), dy = sin (gunangles[i] * M_PI/180.0);
+		traceBeam(game, shot, -375.0 + 85.0 * dx, gunys[i] + 85.0 * dy, gunangles[i], dx, dy);
+		bounces += shot.legs;
+	}
+	tracesink = bounces;
+	return n;
+}
+
+/* Score layout - the lit segments and placement of every digit of n scores */
+static vector<int> scores;
+static volatile int layoutsink;
+static void setupScoreLayout (int n)
+{
+	srand(BENCH_SEED);
+	scores.resize(n);
+	for (int i = 0; i < n; i++)
+		scores[i] = rand() % 100000;
+}
+static long runScoreLayout (int n)
+{
+	char text[16];
+	int lit = 0;
+	for (int i = 0; i < n; i++){
+		snprintf(text, sizeof(text), "%d", scores[i]);
+		layoutText(text, SCORE_X, SCORE_Y, 1.0, ALIGN_RIGHT, [&] (float x, float /*y*/, float /*width*/, float /*height*/) {
+			lit += (int) x;
+		});
+	}
+	layoutsink = lit;
+	return n;
+}
+
+/* Spawn - n bricks created, then the field emptied again */
+static void setupSpawn (int n)
+{
+	seedRandom(game.spawnrng, BENCH_SEED);
+	resetGame(game);
+	game.bricks.reserve(n);
+}
+static long runSpawn (int n)
+{
+	for (int i = 0; i < n; i++)
+		spawnBrick(game);
+	game.bricks.clear();
+	return n;
+}
+
+/* Environment step - n steps of the RL interface under random actions, restarting each game that ends */
+static Env *benchenv;
+static Random envpolicy;
+static float envobs[ENV_OBS_SIZE];
+static void setupEnvStep (int /*n*/)
+{
+	if (!benchenv)
+		benchenv = envCreate();
+	seedRandom(envpolicy, BENCH_SEED);
+	envReset(benchenv, BENCH_SEED, envobs);
+}
+static long runEnvStep (int n)
+{
+	float reward;
+	int done;
+	for (int i = 0; i < n; i++){
+		envStep(benchenv, randomBelow(envpolicy, NUM_ACTIONS), envobs, &reward, &done);
+		if (done)
+			envReset(benchenv, BENCH_SEED + i, envobs);
+	}
+	return n;
+}
+
+/* Batched environment step - one step of a batch of n environments under random actions */
+static BatchEnv *benchbatch;
+static vector<float> batchobs, batchrewards;
+static vector<int> batchactions, batchdones;
+static void setupBatchEnvStep (int n)
+{
+	if (benchbatch)
+		batchEnvDestroy(benchbatch);
+	benchbatch = batchEnvCreate(n);
+	batchobs.resize((size_t) n * ENV_OBS_SIZE);
+	batchrewards.resize(n);
+	batchactions.resize(n);
+	batchdones.resize(n);
+	seedRandom(envpolicy, BENCH_SEED);
+	batchEnvReset(benchbatch, BENCH_SEED, batchobs.data());
+}
+static long runBatchEnvStep (int n)
+{
+	for (int i = 0; i < n; i++)
+		batchactions[i] = randomBelow(envpolicy, NUM_ACTIONS);
+	batchEnvStep(benchbatch, batchactions.data(), batchobs.data(), batchrewards.data(), batchdones.data());
+	return n;
+}
+
+/* Software rendering - n 84x84 grayscale frames, drawn in batches of RASTER_BATCH games a minute into play */
+const int RASTER_BATCH = 16;
+const int RASTER_SIZE = 84;
+static vector<GameInstance> rastergames;
+static vector<unsigned char> rasterframes;
+static void setupRaster (int /*n*/)
+{
+	if (!rastergames.empty())
+		return;
+	rastergames.resize(RASTER_BATCH);
+	Random policy;
+	seedRandom(policy, BENCH_SEED);
+	for (int g = 0; g < RASTER_BATCH; g++){
+		initGame(rastergames[g], BENCH_SEED + g);
+		for (int t = 0; t < 3600 && !rastergames[g].gameover; t++){
+			applyAction(rastergames[g], randomBelow(policy, NUM_ACTIONS));
+			update(rastergames[g], TICK);
+		}
+	}
+	rasterframes.resize(RASTER_BATCH * RASTER_SIZE * RASTER_SIZE);
+}
+static long runRaster (int n)
+{
+	for (int i = 0; i < n; i += RASTER_BATCH)
+		rasterGames(rastergames.data(), min(RASTER_BATCH, n - i), rasterframes.data(), RASTER_SIZE, RASTER_SIZE, 1);
+	return n;
+}
+
+const Benchmark benchmarks[] = {
+	{"brick_update", setupBrickUpdate, runBrickUpdate},
+	{"collision", setupCollision, runCollision},
+	{"reflection", setupReflection, runReflection},
+	{"score_layout", setupScoreLayout, runScoreLayout},
+	{"spawn", setupSpawn, runSpawn},
+	{"env_step", setupEnvStep, runEnvStep},
+	{"batch_env_step", setupBatchEnvStep, runBatchEnvStep},
+	{"raster", setupRaster, runRaster},
+};
+const int NUM_BENCHMARKS = sizeof(benchmarks)/sizeof(benchmarks[0]);
+
+const int benchcounts[] = {10, 100, 1000, 10000, 100000, 1000000};
+const int NUM_BENCHCOUNTS = sizeof(benchcounts)/sizeof(benchcounts[0]);
+
+/* Check fallBricks' SIMD lanes against fallBricksScalar on every kind, every bucket state and every start - over */
+/* the red bucket, the blue one, neither, or straddling the red one's edge; crossing the bucket line this pass, */
+/* crossing the bottom of the screen, or well above both - shifted across the lanes by 0 to 3 leading bricks */
+static int checkFallBricks ()
+{
+	const float xs[4] = {200.0, -200.0, 0.0, 245.0};
+	const float ys[3] = {-240.0 + BENCH_FALL / 2.0, -350.0 + BENCH_FALL / 2.0, 0.0};
+	const Object2D &red = game.buckets[game.redBucket], &blue = game.buckets[game.blueBucket];
+	for (int lead = 0; lead < 4; lead++){
+		BrickField simd;
+		for (int i = 0; i < lead; i++)
+			simd.add(0.0, 100.0, 10.0, 20.0, BRICK_RED);
+		for (int kind = 0; kind < NUM_BRICK_KINDS; kind++)
+			for (int x = 0; x < 4; x++)
+				for (int y = 0; y < 3; y++)
+					for (int active = 0; active < 3; active++){
+						simd.active[simd.add(xs[x], ys[y], 10.0, 20.0, kind)] = active;
+					}
+		BrickField scalar = simd;
+		int caught, blackcaught, scalarcaught, scalarblackcaught;
+		fallBricks(simd, BENCH_FALL, red, blue, caught, blackcaught);
+		fallBricksScalar(scalar, BENCH_FALL, red, blue, scalarcaught, scalarblackcaught);
+		if (caught != scalarcaught || blackcaught != scalarblackcaught){
+			fprintf(stderr, "bench: fallBricks caught %d and %d black, the scalar path %d and %d (n = %d)\n",
+				caught, blackcaught, scalarcaught, scalarblackcaught, simd.size());
+			return 0;
+		}
+		for (int i = 0; i < simd.size(); i++)
+			if (simd.y[i] != scalar.y[i] || simd.active[i] != scalar.active[i]){
+				fprintf(stderr, "bench: fallBricks left brick %d of %d at y %g, active %d, the scalar path at y %g, active %d\n",
+					i, simd.size(), simd.y[i], simd.active[i], scalar.y[i], scalar.active[i]);
+				return 0;
+			}
+	}
+	return 1;
+}
+
+static double now ()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main (int argc, char** argv)
+{
+	const char *filter = NULL;
+	const char *outpath = NULL;
+	double mintime = 0.2;
+	int maxcount = 1000000;
+
+	for (int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc)
+			filter = argv[++i];
+		else if (arg == "--out" && i + 1 < argc)
+			outpath = argv[++i];
+		else if (arg == "--min-time" && i + 1 < argc)
+			mintime = atof(argv[++i]);
+		else if (arg == "--max" && i + 1 < argc)
+			maxcount = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [--filter NAME] [--out FILE] [--min-time SECONDS] [--max N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	FILE *out = stdout;
+	if (outpath && !(out = fopen(outpath, "w"))){
+		fprintf(stderr, "bench: cannot open %s\n", outpath);
+		return 1;
+	}
+
+	initGame(game, BENCH_SEED);
+	if (!checkFallBricks())
+		return 1;
+
+	fprintf(out, "{\n  \"context\": {\"seed\": %u, \"min_time\": %g},\n  \"benchmarks\": [", BENCH_SEED, mintime);
+	int first = 1;
+	for (int b = 0; b < NUM_BENCHMARKS; b++){
+		if (filter && !strstr(benchmarks[b].name, filter))
+			continue;
+		for (int c = 0; c < NUM_BENCHCOUNTS && benchcounts[c] <= maxcount; c++){
+			int n = benchcounts[c];
+			benchmarks[b].setup(n);
+			benchmarks[b].run(n);	// warm up caches and lazily sized buffers
+
+			// Run batches of doubling size until one takes at least mintime
+			long iterations = 1, items;
+			double elapsed;
+			for (;;){
+				items = 0;
+				double start = now();
+				for (long i = 0; i < iterations; i++)
+					items += benchmarks[b].run(n);
+				elapsed = now() - start;
+				if (elapsed >= mintime || iterations >= (1L << 30))
+					break;
+				iterations *= 2;
+			}
+
+			fprintf(out, "%s\n    {\"name\": \"%s/%d\", \"iterations\": %ld, \"real_time\": %.1f, \"time_unit\": \"ns\", \"items_per_second\": %.0f}",
+				first ? "" : ",", benchmarks[b].name, n, iterations, elapsed * 1e9 / iterations, items / elapsed);
+			first = 0;
+			fprintf(stderr, "%-14s %8d  %12.1f ns  %14.0f items/s\n", benchmarks[b].name, n, elapsed * 1e9 / iterations, items / elapsed);
+		}
+	}
+	fprintf(out, "\n  ]\n}\n");
+	if (out != stdout)
+		fclose(out);
+
+	resetGame(game);
+	return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef BRICKFIELD_H
+#define BRICKFIELD_H
+
+#include <vector>
+
+/* Bricks stored as one array per field, so the per-tick fall only streams through the y, kind and active arrays */
+/* Brick i is x[i], y[i], ... - removing a brick moves the last one into its place */
+struct BrickField {
+	std::vector<float> x, y, prevy;
+	std::vector<float> width, height;
+	std::vector<int> kind;
+	std::vector<int> active;
+
+	int add (float bx, float by, float bwidth, float bheight, int bkind)
+	{
+		x.push_back(bx);
+		y.push_back(by);
+		prevy.push_back(by);
+		width.push_back(bwidth);
+		height.push_back(bheight);
+		kind.push_back(bkind);
+		active.push_back(1);
+		return x.size() - 1;
+	}
+
+	void remove (int i)
+	{
+		int last = x.size() - 1;
+		if (i != last) {
+			x[i] = x[last];
+			y[i] = y[last];
+			prevy[i] = prevy[last];
+			width[i] = width[last];
+			height[i] = height[last];
+			kind[i] = kind[last];
+			active[i] = active[last];
+		}
+		x.pop_back();
+		y.pop_back();
+		prevy.pop_back();
+		width.pop_back();
+		height.pop_back();
+		kind.pop_back();
+		active.pop_back();
+	}
+
+	/* Remove every brick whose active flag equals deadstate */
+	void reclaim (int deadstate)
+	{
+		// Walk backwards so the brick moved into a hole has already been checked
+		for (int i = x.size() - 1; i >= 0; i--){
+			if (active[i] == deadstate)
+				remove(i);
+		}
+	}
+
+	void clear ()
+	{
+		x.clear();
+		y.clear();
+		prevy.clear();
+		width.clear();
+		height.clear();
+		kind.clear();
+		active.clear();
+	}
+
+	void reserve (int n)
+	{
+		x.reserve(n);
+		y.reserve(n);
+		prevy.reserve(n);
+		width.reserve(n);
+		height.reserve(n);
+		kind.reserve(n);
+		active.reserve(n);
+	}
+
+	int size () const { return x.size(); }
+	bool empty () const { return x.empty(); }
+};
+typedef struct BrickField BrickField;
+
+#endif
@@ -0,0 +1,325 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glad/glad.h>
+
+#include "Capture.h"
+#include "Trace.h"
+
+using namespace std;
+
+/* Readbacks in flight - a frame is collected CAPTURE_PBOS - 1 frames after it was drawn at the latest */
+const int CAPTURE_PBOS = 4;
+/* Frames waiting for the encoder before new ones are dropped */
+const int CAPTURE_QUEUE = 16;
+
+struct Capture {
+	int active;
+	int width, height;
+	int y4m;
+	string path;
+	FILE *out;		// the .y4m stream; PNG frames each get their own file
+
+	// Ring of readbacks: the pending ones end just before head, oldest first
+	GLuint pbos[CAPTURE_PBOS];
+	GLsync fences[CAPTURE_PBOS];
+	int head, pending;
+
+	// Frames handed to the encoder, and emptied buffers for reuse - both guarded by lock
+	thread encoder;
+	mutex lock;
+	condition_variable wake;
+	deque<vector<unsigned char>*> queue;
+	vector<vector<unsigned char>*> spare;
+	int stopping;
+	long written, dropped;
+};
+typedef struct Capture Capture;
+
+static Capture capture;
+
+/* Y4M frame - full range BT.601, chroma averaged over 2x2 pixels, from bottom-up RGBA rows */
+static void writeY4MFrame (FILE *out, const unsigned char *rgba, int width, int height, vector<unsigned char> &yuv)
+{
+	int cw = (width + 1) / 2, ch = (height + 1) / 2;
+	yuv.resize((size_t) width * height + 2 * cw * ch);
+	unsigned char *py = &yuv[0], *pu = py + (size_t) width * height, *pv = pu + cw * ch;
+	for (int y = 0; y < height; y++){
+		const unsigned char *row = rgba + (size_t) (height - 1 - y) * width * 4;
+		for (int x = 0; x < width; x++){
+			const unsigned char *p = row + 4 * x;
+			py[(size_t) y * width + x] = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+		}
+	}
+	for (int cy = 0; cy < ch; cy++)
+		for (int cx = 0; cx < cw; cx++){
+			int r = 0, g = 0, b = 0, n = 0;
+			for (int y = 2 * cy; y < 2 * cy + 2 && y < height; y++)
+				for (int x = 2 * cx; x < 2 * cx + 2 && x < width; x++){
+					const unsigned char *p = rgba + ((size_t) (height - 1 - y) * width + x) * 4;
+					r += p[0];
+					g += p[1];
+					b += p[2];
+					n ++;
+				}
+			r /= n;
+			g /= n;
+			b /= n;
+			pu[cy * cw + cx] = (-43 * r - 85 * g + 128 * b + 32768 + 128) >> 8;
+			pv[cy * cw + cx] = (128 * r - 107 * g - 21 * b + 32768 + 128) >> 8;
+		}
+	fputs("FRAME\n", out);
+	fwrite(&yuv[0], 1, yuv.size(), out);
+}
+
+static unsigned int crcTable[256];
+
+static unsigned int crc32 (unsigned int crc, const unsigned char *data, size_t n)
+{
+	if (!crcTable[1])
+		for (unsigned int i = 0; i < 256; i++){
+			unsigned int c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crcTable[i] = c;
+		}
+	crc = ~crc;
+	for (size_t i = 0; i < n; i++)
+		crc = crcTable[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void putBigEndian (unsigned char *p, unsigned int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void writeChunk (FILE *out, const char *type, const unsigned char *data, size_t n)
+{
+	unsigned char word[4];
+	putBigEndian(word, n);
+	fwrite(word, 1, 4, out);
+	unsigned int crc = crc32(0, (const unsigned char *) type, 4);
+	crc = crc32(crc, data, n);
+	fwrite(type, 1, 4, out);
+	fwrite(data, 1, n, out);
+	putBigEndian(word, crc);
+	fwrite(word, 1, 4, out);
+}
+
+/* PNG frame - RGB, with the image data in stored (uncompressed) deflate blocks, so no zlib is needed and */
+/* encoding costs no more than a copy */
+static int writePNGFrame (const char *path, const unsigned char *rgba, int width, int height, vector<unsigned char> &buf)
+{
+	FILE *out = fopen(path, "wb");
+	if (!out)
+		return 0;
+	static const unsigned char signature[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+	fwrite(signature, 1, 8, out);
+	unsigned char header[13] = {0};
+	putBigEndian(header, width);
+	putBigEndian(header + 4, height);
+	header[8] = 8;	// bits per channel
+	header[9] = 2;	// RGB
+	writeChunk(out, "IHDR", header, 13);
+
+	// Each row is a filter byte (0, none) and its pixels, top row first
+	size_t rowbytes = 1 + (size_t) width * 3, raw = rowbytes * height;
+	size_t blocks = (raw + 65534) / 65535;
+	buf.resize(2 + raw + 5 * blocks + 4);
+	unsigned char *p = &buf[0];
+	*p++ = 0x78;
+	*p++ = 0x01;
+	unsigned int a = 1, b = 0;	// Adler-32 of the raw data
+	size_t left = raw, inblock = 0;
+	for (int y = 0; y < height; y++){
+		const unsigned char *row = rgba + (size_t) (height - 1 - y) * width * 4;
+		for (int x = -1; x < width * 3; x++){
+			if (inblock == 0){
+				size_t n = left < 65535 ? left : 65535;
+				*p++ = left == n;	// last block
+				*p++ = n & 0xff;
+				*p++ = n >> 8;
+				*p++ = ~n & 0xff;
+				*p++ = (~n >> 8) & 0xff;
+				inblock = n;
+				left -= n;
+			}
+			unsigned char v = x < 0 ? 0 : row[x / 3 * 4 + x % 3];
+			*p++ = v;
+			inblock --;
+			a = (a + v) % 65521;
+			b = (b + a) % 65521;
+		}
+	}
+	putBigEndian(p, (b << 16) | a);
+	writeChunk(out, "IDAT", &buf[0], buf.size());
+	writeChunk(out, "IEND", NULL, 0);
+	int ok = !ferror(out);
+	fclose(out);
+	return ok;
+}
+
+static void encodeFrames ()
+{
+	vector<unsigned char> scratch;
+	long frameno = 0;
+	for (;;){
+		vector<unsigned char> *frame;
+		{
+			unique_lock<mutex> guard(capture.lock);
+			while (capture.queue.empty() && !capture.stopping)
+				capture.wake.wait(guard);
+			if (capture.queue.empty())
+				return;
+			frame = capture.queue.front();
+			capture.queue.pop_front();
+		}
+		TRACE_SCOPE("encode");
+		if (capture.y4m)
+			writeY4MFrame(capture.out, &(*frame)[0], capture.width, capture.height, scratch);
+		else {
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/frame%06ld.png", capture.path.c_str(), frameno);
+			if (!writePNGFrame(path, &(*frame)[0], capture.width, capture.height, scratch))
+				fprintf(stderr, "capture: cannot write %s\n", path);
+		}
+		frameno ++;
+		lock_guard<mutex> guard(capture.lock);
+		capture.spare.push_back(frame);
+		capture.written ++;
+	}
+}
+
+int startCapture (const char *path, int width, int height)
+{
+	capture.path = path;
+	capture.width = width;
+	capture.height = height;
+	capture.y4m = capture.path.size() > 4 && capture.path.compare(capture.path.size() - 4, 4, ".y4m") == 0;
+	capture.out = NULL;
+	if (capture.y4m){
+		capture.out = fopen(path, "wb");
+		if (!capture.out){
+			fprintf(stderr, "capture: cannot write %s\n", path);
+			return 0;
+		}
+		// 60 frames a second is what the window shows with vsync; C420jpeg and full range match the conversion
+		fprintf(capture.out, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height);
+	}
+
+	glGenBuffers(CAPTURE_PBOS, capture.pbos);
+	for (int i = 0; i < CAPTURE_PBOS; i++){
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbos[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	capture.head = 0;
+	capture.pending = 0;
+	capture.stopping = 0;
+	capture.written = 0;
+	capture.dropped = 0;
+	capture.encoder = thread(encodeFrames);
+	capture.active = 1;
+	return 1;
+}
+
+/* Copy a finished readback out of its buffer and hand it to the encoder */
+static void collectFrame (int slot)
+{
+	glDeleteSync(capture.fences[slot]);
+	vector<unsigned char> *frame = NULL;
+	{
+		lock_guard<mutex> guard(capture.lock);
+		if ((int) capture.queue.size() >= CAPTURE_QUEUE){
+			capture.dropped ++;
+			return;
+		}
+		if (!capture.spare.empty()){
+			frame = capture.spare.back();
+			capture.spare.pop_back();
+		}
+	}
+	if (!frame)
+		frame = new vector<unsigned char>((size_t) capture.width * capture.height * 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbos[slot]);
+	void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame->size(), GL_MAP_READ_BIT);
+	if (pixels){
+		memcpy(&(*frame)[0], pixels, frame->size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	lock_guard<mutex> guard(capture.lock);
+	if (!pixels){
+		capture.spare.push_back(frame);
+		capture.dropped ++;
+		return;
+	}
+	capture.queue.push_back(frame);
+	capture.wake.notify_one();
+}
+
+void captureFrame ()
+{
+	if (!capture.active)
+		return;
+	TRACE_SCOPE("capture");
+	// Collect every readback the GPU has finished, oldest first, without waiting on any
+	while (capture.pending > 0){
+		int oldest = (capture.head - capture.pending + CAPTURE_PBOS) % CAPTURE_PBOS;
+		GLenum state = glClientWaitSync(capture.fences[oldest], 0, 0);
+		if (state != GL_ALREADY_SIGNALED && state != GL_CONDITION_SATISFIED)
+			break;
+		collectFrame(oldest);
+		capture.pending --;
+	}
+	if (capture.pending == CAPTURE_PBOS){
+		capture.dropped ++;
+		return;
+	}
+	// With a pack buffer bound, glReadPixels returns at once and the copy happens on the GPU's timeline
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbos[capture.head]);
+	glReadPixels(0, 0, capture.width, capture.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	capture.fences[capture.head] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// The fence is only polled later, without the flush bit - and offscreen there is no swap to submit it - so
+	// submit it now, or it may never signal
+	glFlush();
+	capture.head = (capture.head + 1) % CAPTURE_PBOS;
+	capture.pending ++;
+}
+
+void stopCapture ()
+{
+	if (!capture.active)
+		return;
+	while (capture.pending > 0){
+		int oldest = (capture.head - capture.pending + CAPTURE_PBOS) % CAPTURE_PBOS;
+		glClientWaitSync(capture.fences[oldest], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		collectFrame(oldest);
+		capture.pending --;
+	}
+	{
+		lock_guard<mutex> guard(capture.lock);
+		capture.stopping = 1;
+	}
+	capture.wake.notify_one();
+	capture.encoder.join();
+	glDeleteBuffers(CAPTURE_PBOS, capture.pbos);
+	for (size_t i = 0; i < capture.spare.size(); i++)
+		delete capture.spare[i];
+	capture.spare.clear();
+	if (capture.out)
+		fclose(capture.out);
+	capture.active = 0;
+	fprintf(stderr, "capture: %ld frames written to %s, %ld dropped\n", capture.written, capture.path.c_str(), capture.dropped);
+}
@@ -0,0 +1,17 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+/* Recording of the frames drawn to video, without stalling the frame loop. Each frame is read back into one of a */
+/* ring of pixel buffer objects and collected a few frames later once the GPU has finished the copy; a background */
+/* thread converts and writes the frames. When the GPU or the encoder falls behind, frames are dropped rather */
+/* than waited for. */
+
+/* Start capturing width x height frames to path - a .y4m file gets one YUV4MPEG2 stream (4:2:0), anything else */
+/* is taken as an existing directory and gets frame000000.png, frame000001.png, ... Needs a current GL context. */
+int startCapture (const char *path, int width, int height);
+/* Queue a readback of the frame just drawn - call after drawing and before swapping buffers */
+void captureFrame ();
+/* Wait for the frames still in flight, write them and close the output */
+void stopCapture ();
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef DIGITS_H
+#define DIGITS_H
+
+#include <cstring>
+
+/* Layout of the HUD - 7-segment text such as the score, and the life markers - kept free of GL so it can be */
+/* measured and reused without a window */
+
+enum segment { SEG_TOP, SEG_TOPRIGHT, SEG_TOPLEFT, SEG_MIDDLE, SEG_BOTRIGHT, SEG_BOTLEFT, SEG_BOTTOM, NUM_SEGMENTS };
+
+/* Centre and size of each segment, relative to the centre of its character - the one template every character */
+/* is drawn from, at any position and scale */
+struct SegmentRect {
+	float x, y;
+	float width, height;
+};
+typedef struct SegmentRect SegmentRect;
+
+const SegmentRect segmentRects[NUM_SEGMENTS] = {
+	{0.0, 15.0, 20.0, 5.0},		// top
+	{7.5, 7.5, 5.0, 20.0},		// top right
+	{-7.5, 7.5, 5.0, 20.0},		// top left
+	{0.0, 0.0, 20.0, 5.0},		// middle
+	{7.5, -7.5, 5.0, 20.0},		// bottom right
+	{-7.5, -7.5, 5.0, 20.0},	// bottom left
+	{0.0, -15.0, 20.0, 5.0},	// bottom
+};
+
+constexpr int LIT_TOP = 1 << SEG_TOP;
+constexpr int LIT_TOPRIGHT = 1 << SEG_TOPRIGHT;
+constexpr int LIT_TOPLEFT = 1 << SEG_TOPLEFT;
+constexpr int LIT_MIDDLE = 1 << SEG_MIDDLE;
+constexpr int LIT_BOTRIGHT = 1 << SEG_BOTRIGHT;
+constexpr int LIT_BOTLEFT = 1 << SEG_BOTLEFT;
+constexpr int LIT_BOTTOM = 1 << SEG_BOTTOM;
+
+/* A character and the segments lit to show it - letters are looked up by their upper case, whichever form */
+/* (b, d, n, o, r, t, y) reads better on seven segments is the one lit */
+struct Glyph {
+	char c;
+	int lit;
+};
+typedef struct Glyph Glyph;
+
+constexpr Glyph glyphs[] = {
+	{'0', LIT_TOP | LIT_TOPRIGHT | LIT_TOPLEFT | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'1', LIT_TOPRIGHT | LIT_BOTRIGHT},
+	{'2', LIT_TOP | LIT_TOPRIGHT | LIT_MIDDLE | LIT_BOTLEFT | LIT_BOTTOM},
+	{'3', LIT_TOP | LIT_TOPRIGHT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTTOM},
+	{'4', LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT},
+	{'5', LIT_TOP | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTTOM},
+	{'6', LIT_TOP | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'7', LIT_TOP | LIT_TOPRIGHT | LIT_BOTRIGHT},
+	{'8', LIT_TOP | LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'9', LIT_TOP | LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTTOM},
+	{'A', LIT_TOP | LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT},
+	{'B', LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'C', LIT_TOP | LIT_TOPLEFT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'D', LIT_TOPRIGHT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'E', LIT_TOP | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTLEFT | LIT_BOTTOM},
+	{'F', LIT_TOP | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTLEFT},
+	{'G', LIT_TOP | LIT_TOPLEFT | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'H', LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT},
+	{'I', LIT_TOPLEFT | LIT_BOTLEFT},
+	{'J', LIT_TOPRIGHT | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'L', LIT_TOPLEFT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'N', LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT},
+	{'O', LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'P', LIT_TOP | LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTLEFT},
+	{'R', LIT_MIDDLE | LIT_BOTLEFT},
+	{'S', LIT_TOP | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTTOM},
+	{'T', LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTLEFT | LIT_BOTTOM},
+	{'U', LIT_TOPRIGHT | LIT_TOPLEFT | LIT_BOTRIGHT | LIT_BOTLEFT | LIT_BOTTOM},
+	{'Y', LIT_TOPRIGHT | LIT_TOPLEFT | LIT_MIDDLE | LIT_BOTRIGHT | LIT_BOTTOM},
+	{'-', LIT_MIDDLE},
+	{' ', 0},
+};
+constexpr int NUM_GLYPHS = sizeof(glyphs) / sizeof(glyphs[0]);
+
+constexpr int findGlyph (char c, int i)
+{
+	return i == NUM_GLYPHS ? 0 : glyphs[i].c == c ? glyphs[i].lit : findGlyph(c, i + 1);
+}
+
+/* Bit (1 << segment) is set for every segment lit to show c - characters with no glyph show as blanks */
+constexpr int glyphSegments (char c)
+{
+	return findGlyph(c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c, 0);
+}
+
+static_assert(glyphSegments('8') == (1 << NUM_SEGMENTS) - 1, "8 lights every segment");
+static_assert(glyphSegments('e') == glyphSegments('E'), "letters are looked up by their upper case");
+
+/* Distance between the centres of neighbouring characters, at scale 1 */
+const float GLYPH_ADVANCE = 30.0;
+
+enum textalign { ALIGN_LEFT, ALIGN_CENTRE, ALIGN_RIGHT };
+
+/* Call emit(x, y, width, height) with the centre and size of every lit segment of text, scaled by scale - (x, y) */
+/* is the centre of the first, middle or last character as align says */
+template <typename Emit>
+inline void layoutText (const char *text, float x, float y, float scale, int align, Emit emit)
+{
+	int n = strlen(text);
+	float advance = GLYPH_ADVANCE * scale;
+	if(align == ALIGN_RIGHT)
+		x -= advance * (n - 1);
+	else if(align == ALIGN_CENTRE)
+		x -= advance * (n - 1) / 2.0f;
+	for (int i = 0; i < n; i++){
+		int lit = glyphSegments(text[i]);
+		for (int s = 0; s < NUM_SEGMENTS; s++){
+			if(!(lit & (1 << s)))
+				continue;
+			const SegmentRect &seg = segmentRects[s];
+			emit(x + advance * i + seg.x * scale, y + seg.y * scale, seg.width * scale, seg.height * scale);
+		}
+	}
+}
+
+/* The score, right aligned in the top right corner at any width, and the game over banner mid screen */
+const float SCORE_X = 370.0;
+const float SCORE_Y = 250.0;
+const char GAMEOVER_TEXT[] = "End";
+
+/* The life markers beside the score: squares turned 45 degrees, the first one shown until the game is over */
+const float LIFE_X[3] = {310.0, 340.0, 370.0};
+const float LIFE_Y = 200.0;
+const float LIFE_SIZE = 10.0;
+
+#endif
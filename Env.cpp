@@ -0,0 +1,180 @@
+#include <cstring>
+#include <vector>
+
+#include "Game.h"
+#include "Env.h"
+#include "Raster.h"
+
+using namespace std;
+
+struct Env {
+	GameInstance game;
+};
+
+Env *envCreate (void)
+{
+	// Start on seed 0, so stepping before the first reset still plays a real game
+	Env *env = new Env();
+	initGame(env->game, 0);
+	return env;
+}
+
+void envDestroy (Env *env)
+{
+	delete env;
+}
+
+int envObservationSize (void)
+{
+	return ENV_OBS_SIZE;
+}
+
+int envNumActions (void)
+{
+	return NUM_ACTIONS;
+}
+
+/* Fill obs with the layout described in Env.h */
+static void writeObservation (GameInstance &game, float *obs)
+{
+	memset(obs, 0, ENV_OBS_SIZE * sizeof(float));
+	Object2D &arm = game.gunparts[game.gunArm];
+	obs[0] = arm.y / 300.0f;
+	obs[1] = arm.angle / 90.0f;
+	obs[2] = arm.active == 0;
+	obs[3] = game.buckets[game.redBucket].x / 400.0f;
+	obs[4] = game.buckets[game.blueBucket].x / 400.0f;
+	obs[5] = game.brickspeed / 7.0f;
+	obs[6] = game.life / 3.0f;
+
+	// Keep the lowest bricks in order by insertion - there are rarely more than a dozen on screen
+	int lowest[ENV_OBS_BRICKS];
+	int found = 0;
+	BrickField &bricks = game.bricks;
+	for (int i = 0; i < bricks.size(); i++){
+		if(bricks.active[i] == 2)
+			continue;
+		if(found == ENV_OBS_BRICKS && bricks.y[i] >= bricks.y[lowest[found - 1]])
+			continue;
+		int j = found < ENV_OBS_BRICKS ? found++ : found - 1;
+		for (; j > 0 && bricks.y[lowest[j - 1]] > bricks.y[i]; j--)
+			lowest[j] = lowest[j - 1];
+		lowest[j] = i;
+	}
+	float *slot = obs + ENV_OBS_GLOBALS;
+	for (int k = 0; k < found; k++, slot += ENV_OBS_PER_BRICK){
+		int i = lowest[k];
+		slot[0] = bricks.x[i] / 400.0f;
+		slot[1] = bricks.y[i] / 300.0f;
+		slot[2 + bricks.kind[i]] = 1.0f;
+	}
+
+	slot = obs + ENV_OBS_GLOBALS + ENV_OBS_BRICKS * ENV_OBS_PER_BRICK;
+	int beams = 0;
+	for (ObjectPool<Beam> :: iterator it = game.beam.begin(); it != game.beam.end() && beams < ENV_OBS_BEAMS; it++){
+		if(it->active == 0)
+			continue;
+		slot[0] = it->x / 400.0f;
+		slot[1] = it->y / 300.0f;
+		slot[2] = it->dirx;
+		slot[3] = it->diry;
+		slot += ENV_OBS_PER_BEAM;
+		beams ++;
+	}
+}
+
+/* Start a new game in place - initGame expects a fresh instance, and a fresh one also puts the gun and buckets back */
+static void restartGame (GameInstance &game, unsigned int seed)
+{
+	game = GameInstance();
+	initGame(game, seed);
+}
+
+void envReset (Env *env, unsigned int seed, float *obs)
+{
+	restartGame(env->game, seed);
+	writeObservation(env->game, obs);
+}
+
+void envStep (Env *env, int action, float *obs, float *reward, int *done)
+{
+	GameInstance &game = env->game;
+	int score = game.totalscore;
+	if(action >= 0 && action < NUM_ACTIONS)
+		applyAction(game, action);
+	update(game, TICK);
+	writeObservation(game, obs);
+	*reward = game.totalscore - score;
+	*done = game.gameover;
+}
+
+int envRender (Env *env, unsigned char *pixels, int width, int height, int channels)
+{
+	if(channels != 1 && channels != 3)
+		return 0;
+	rasterGame(env->game, pixels, width, height, channels);
+	return 1;
+}
+
+struct BatchEnv {
+	std::vector<GameInstance> games;
+	unsigned int nextseed;	// for the next game to start
+};
+
+BatchEnv *batchEnvCreate (int n)
+{
+	BatchEnv *batch = new BatchEnv();
+	batch->games.resize(n);
+	// As if reset with seed 0
+	for (int i = 0; i < n; i++)
+		initGame(batch->games[i], i);
+	batch->nextseed = n;
+	return batch;
+}
+
+void batchEnvDestroy (BatchEnv *batch)
+{
+	delete batch;
+}
+
+int batchEnvSize (BatchEnv *batch)
+{
+	return batch->games.size();
+}
+
+void batchEnvReset (BatchEnv *batch, unsigned int seed, float *obs)
+{
+	int n = batch->games.size();
+	for (int i = 0; i < n; i++){
+		restartGame(batch->games[i], seed + i);
+		writeObservation(batch->games[i], obs + i * ENV_OBS_SIZE);
+	}
+	batch->nextseed = seed + n;
+}
+
+void batchEnvStep (BatchEnv *batch, const int *actions, float *obs, float *rewards, int *dones)
+{
+	// Each game is taken through its whole step before the next, so its state is pulled into cache once per step
+	int n = batch->games.size();
+	for (int i = 0; i < n; i++){
+		GameInstance &game = batch->games[i];
+		int score = game.totalscore;
+		if(actions[i] >= 0 && actions[i] < NUM_ACTIONS)
+			applyAction(game, actions[i]);
+		update(game, TICK);
+		rewards[i] = game.totalscore - score;
+		dones[i] = game.gameover;
+		// Environments are restarted in index order, so the seeds they get depend only on the actions taken
+		if(dones[i])
+			restartGame(game, batch->nextseed++);
+		writeObservation(game, obs + i * ENV_OBS_SIZE);
+	}
+}
+
+int batchEnvRender (BatchEnv *batch, unsigned char *pixels, int width, int height, int channels)
+{
+	if(channels != 1 && channels != 3)
+		return 0;
+	rasterGames(batch->games.data(), batch->games.size(), pixels, width, height, channels);
+	return 1;
+}
@@ -0,0 +1,67 @@
+#ifndef ENV_H
+#define ENV_H
+
+/* Reinforcement learning interface to the game - reset, then step one tick per action - with a plain C API so it */
+/* can be loaded from Python (ctypes, cffi) or any other language. No window or GL; environments share nothing, so */
+/* any number can be stepped at once from different threads. */
+
+/* Actions are the game's discrete actions, numbered as in enum action: 0 none, 1 tiltup, 2 tiltdown, 3 up, 4 down, */
+/* 5 fire, 6 redleft, 7 redright, 8 blueleft, 9 blueright, 10 faster, 11 slower */
+
+/* The observation is ENV_OBS_SIZE floats, positions scaled to about -1 to 1:
+ *   gun y, gun angle, gun ready to fire, red bucket x, blue bucket x, brick speed, lives left
+ *   then the ENV_OBS_BRICKS lowest bricks still falling, lowest first: x, y, is red, is blue, is black
+ *   then up to ENV_OBS_BEAMS live beams: x, y, direction x, direction y
+ * Slots without a brick or beam are all zero. */
+#define ENV_OBS_BRICKS 8
+#define ENV_OBS_BEAMS 4
+#define ENV_OBS_GLOBALS 7
+#define ENV_OBS_PER_BRICK 5
+#define ENV_OBS_PER_BEAM 4
+#define ENV_OBS_SIZE (ENV_OBS_GLOBALS + ENV_OBS_BRICKS * ENV_OBS_PER_BRICK + ENV_OBS_BEAMS * ENV_OBS_PER_BEAM)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Env Env;
+
+/* A new environment starts with the game envReset(env, 0, obs) would start */
+Env *envCreate (void);
+void envDestroy (Env *env);
+
+int envObservationSize (void);
+int envNumActions (void);
+
+/* Start a new game with bricks spawned from seed and write its first observation to obs */
+void envReset (Env *env, unsigned int seed, float *obs);
+/* Apply action, advance the game one tick and write the new observation to obs; reward is the change in score */
+/* and done is set once the game is over, after which the environment must be reset */
+void envStep (Env *env, int action, float *obs, float *reward, int *done);
+/* Draw the game as it stands into pixels, width * height * channels bytes with channels 1 (grayscale) or 3 (RGB), */
+/* scaled from the 800x600 playfield - returns 0 for any other channel count */
+int envRender (Env *env, unsigned char *pixels, int width, int height, int channels);
+
+/* A batch of environments stepped with one call. The games are still stepped one after another - what the batch */
+/* saves is a call per environment - with observations going straight into one caller-provided buffer of */
+/* n * ENV_OBS_SIZE floats, environment i's at obs + i * ENV_OBS_SIZE, and rewards and dones in arrays of n */
+typedef struct BatchEnv BatchEnv;
+
+/* Like envCreate, a new batch starts with the games batchEnvReset(batch, 0, obs) would start */
+BatchEnv *batchEnvCreate (int n);
+void batchEnvDestroy (BatchEnv *batch);
+int batchEnvSize (BatchEnv *batch);
+
+/* Start every game, environment i with bricks spawned from seed + i */
+void batchEnvReset (BatchEnv *batch, unsigned int seed, float *obs);
+/* Apply actions[i] to environment i and advance every game one tick. A game that ends has dones[i] set and is */
+/* restarted at once with the next unused seed, so obs then holds the new game's first observation */
+void batchEnvStep (BatchEnv *batch, const int *actions, float *obs, float *rewards, int *dones);
+/* Draw every game into consecutive frames of pixels, environment i's at pixels + i * width * height * channels */
+int batchEnvRender (BatchEnv *batch, unsigned char *pixels, int width, int height, int channels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,636 @@
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include "Game.h"
+#include "Trace.h"
+#include "Replay.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+bool operator==(const color& lhs, const color& rhs)
+{
+    return (lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b);
+}
+
+
+
+color red = {1, 0, 0};
+color blue = {0, 1, 1};
+color black = {0, 0, 0};
+color grey = {168.0/255.0, 168.0/255.0, 168.0/255.0};
+color green = {0.5, 0, 1};
+color yellow = {1, 1, 0};
+color brickColors[NUM_BRICK_KINDS] = {red, blue, black};
+
+Handle createRectangle (ObjectPool<Object2D> &objclass, color objcolor, float angle, float x, float y, float height, float width)
+{
+	Object2D obj = {};
+	obj.x = x;
+	obj.y = y;
+	obj.prevx = x;
+	obj.prevy = y;
+	obj.height = height;
+	obj.width = width;
+	setAngle(obj, angle);
+	obj.objcolor = objcolor;
+	obj.active = 1;
+	return objclass.add(obj);
+}
+/* Angles only change on input, firing and reflection, so the unit direction is worked out then rather than on every use */
+void setAngle (Object2D &obj, float angle)
+{
+	obj.angle = angle;
+	obj.dirx = cos (angle * M_PI/180.0);
+	obj.diry = sin (angle * M_PI/180.0);
+}
+void moveGunUporDown(GameInstance &game, int dir)
+{
+	for (ObjectPool<Object2D> :: iterator it = game.gunparts.begin(); it != game.gunparts.end(); it++){
+		if(dir == 1 && it->y <= 200)
+			it->y += 10;
+		else if (dir == -1 && it->y >= -150)
+			it->y -= 10;
+		
+	}
+}
+void tiltGunUporDown(GameInstance &game, int dir)
+{
+	if(dir == 1){
+		if(game.gunparts[game.gunArm].angle < 60.0)
+			setAngle(game.gunparts[game.gunArm], game.gunparts[game.gunArm].angle + 10.0);
+		if(game.gunparts[game.gunBase2].angle < 105.0)
+			setAngle(game.gunparts[game.gunBase2], game.gunparts[game.gunBase2].angle + 10.0);
+	}
+	if(dir == -1){
+		if(game.gunparts[game.gunArm].angle > -60.0)
+			setAngle(game.gunparts[game.gunArm], game.gunparts[game.gunArm].angle - 10.0);
+		if(game.gunparts[game.gunBase2].angle > -15.0)
+			setAngle(game.gunparts[game.gunBase2], game.gunparts[game.gunBase2].angle - 10.0);
+	}
+}
+void moveBucket(GameInstance &game, int color, int dir)
+{
+	if(color == 0 && dir == 1){
+		if(game.buckets[game.redBucket].x <= 340.0)
+		game.buckets[game.redBucket].x += 10;
+	}
+	if(color == 0 && dir == -1){
+		if(game.buckets[game.redBucket].x >= -340.0)
+			game.buckets[game.redBucket].x -= 10;
+	}
+	if(color == 1 && dir == 1){
+		if(game.buckets[game.blueBucket].x <= 340.0)
+		game.buckets[game.blueBucket].x += 10;
+	}
+	if(color == 1 && dir == -1){
+		if(game.buckets[game.blueBucket].x >= -340.0)
+			game.buckets[game.blueBucket].x -= 10;
+	}
+}
+/* Follow a laser fired from (x, y) at angle through the mirrors until it leaves the playfield or hits the back of a mirror */
+/* Each mirror is the segment of its length through its centre; the side a beam approaches from decides between reflecting and absorbing */
+void traceBeam (GameInstance &game, Beam &shot, float x, float y, float angle, float dx, float dy)
+{
+	shot.legs = 0;
+	shot.pathx[0] = x;
+	shot.pathy[0] = y;
+	shot.pathlen[0] = 0.0;
+	shot.leg = 0;
+	shot.travelled = 0.0;
+	shot.prevtravelled = 0.0;
+	if(x < -400.0 || x > 400.0 || y < -300.0 || y > 300.0)
+		return;
+	Object2D *last = NULL;
+	while(shot.legs <= MAX_BEAM_BOUNCES){
+		// Distance to the edge of the playfield
+		float tx = dx > 0 ? (400.0 - x)/dx : (dx < 0 ? (-400.0 - x)/dx : 1e9);
+		float ty = dy > 0 ? (300.0 - y)/dy : (dy < 0 ? (-300.0 - y)/dy : 1e9);
+		float tbest = min(tx, ty);
+
+		// Nearest mirror in the way: solve (x, y) + t d = centre + u e with |u| within half the mirror
+		Object2D *hit = NULL;
+		for (ObjectPool<Object2D> :: iterator it = game.mirrors.begin(); it != game.mirrors.end(); it++){
+			if(&*it == last)
+				continue;
+			float ex = it->dirx, ey = it->diry;
+			float denom = dx * ey - dy * ex;
+			if(fabs(denom) < 1e-6)
+				continue;
+			float rx = it->x - x, ry = it->y - y;
+			float t = (rx * ey - ry * ex)/denom;
+			float u = (rx * dy - ry * dx)/denom;
+			if(t > 1e-3 && t < tbest && fabs(u) <= it->width/2.0){
+				tbest = t;
+				hit = &*it;
+			}
+		}
+
+		shot.pathangle[shot.legs] = angle;
+		shot.pathdx[shot.legs] = dx;
+		shot.pathdy[shot.legs] = dy;
+		x += tbest * dx;
+		y += tbest * dy;
+		shot.legs ++;
+		shot.pathx[shot.legs] = x;
+		shot.pathy[shot.legs] = y;
+		shot.pathlen[shot.legs] = shot.pathlen[shot.legs - 1] + tbest;
+		if(hit == NULL)
+			break;
+		// A beam heading along the mirror's normal is approaching its back face, which absorbs it
+		float nx = -hit->diry, ny = hit->dirx;
+		float dn = dx * nx + dy * ny;
+		if(dn > 0)
+			break;
+		// Reflect d about the mirror: d - 2 (d.n) n
+		dx -= 2.0 * dn * nx;
+		dy -= 2.0 * dn * ny;
+		angle = 2.0 * hit->angle - angle;
+		last = hit;
+	}
+}
+
+/* Put the beam's rectangle where its tip has travelled along the path */
+void placeBeam (Beam &shot)
+{
+	while(shot.leg < shot.legs - 1 && shot.travelled > shot.pathlen[shot.leg + 1])
+		shot.leg ++;
+	if(shot.legs == 0){
+		shot.x = shot.pathx[0];
+		shot.y = shot.pathy[0];
+		return;
+	}
+	float along = min(shot.travelled, shot.pathlen[shot.legs]) - shot.pathlen[shot.leg];
+	shot.angle = shot.pathangle[shot.leg];
+	shot.dirx = shot.pathdx[shot.leg];
+	shot.diry = shot.pathdy[shot.leg];
+	shot.x = shot.pathx[shot.leg] + (along - BEAM_TIP) * shot.dirx;
+	shot.y = shot.pathy[shot.leg] + (along - BEAM_TIP) * shot.diry;
+}
+
+void firegun(GameInstance &game)
+{
+	if(game.gunparts[game.gunArm].active == 0)
+	{
+		game.last_beam_time = game.simtime;
+		Beam shot = Beam();
+		shot.height = 1.0;
+		shot.width = 30.0;
+		shot.objcolor = red;
+		shot.active = 1;
+		Object2D &arm = game.gunparts[game.gunArm];
+		traceBeam(game, shot, arm.x - 375.0 + (70.0 + BEAM_TIP) * arm.dirx, arm.y + (70.0 + BEAM_TIP) * arm.diry,
+			arm.angle, arm.dirx, arm.diry);
+		placeBeam(shot);
+		shot.prevx = shot.x;
+		shot.prevy = shot.y;
+		game.beam.add(shot);
+		game.gunparts[game.gunArm].active = 1;
+	}
+
+}
+int bottomCollision (Object2D a, Object2D b)
+{
+	if((a.y - (a.height)/2.0) < (b.y + (b.height)/2.0)){
+		if(((a.x + (a.width)/2.0) < (b.x + (b.width)/2.0)) && ((a.x - (a.width)/2.0) > (b.x - (b.width)/2.0)))
+			return 1;
+	}
+	return 0;
+}
+
+/* Extents of a bucket's top edge, in the form fallBricks compares against */
+struct BucketEdge {
+	float top, left, right;
+};
+typedef struct BucketEdge BucketEdge;
+
+static BucketEdge bucketEdge (const Object2D &b)
+{
+	BucketEdge e = {b.y + b.height/2.0f, b.x - b.width/2.0f, b.x + b.width/2.0f};
+	return e;
+}
+
+/* One brick of fallBricks - the same test as bottomCollision against each bucket */
+static inline void fallBrick (BrickField &field, int i, float fall, const BucketEdge &r, const BucketEdge &b, int &caught, int &blackcaught)
+{
+	if(field.active[i] == 2)
+		return;
+	float y = field.y[i] -= fall;
+	if(field.active[i] == 1 && y < -240.0f){
+		float bottom = y - field.height[i]/2.0f;
+		float left = field.x[i] - field.width[i]/2.0f, right = field.x[i] + field.width[i]/2.0f;
+		int inred = bottom < r.top && right < r.right && left > r.left;
+		int inblue = bottom < b.top && right < b.right && left > b.left;
+		int kind = field.kind[i];
+		if((kind == BRICK_RED && inred) || (kind == BRICK_BLUE && inblue)){
+			caught ++;
+			field.active[i] = 2;
+		}
+		else if(kind == BRICK_BLACK && (inred || inblue)){
+			blackcaught ++;
+			field.active[i] = 2;
+		}
+		else
+			field.active[i] = 0;
+	}
+	// Bricks that missed the buckets keep falling until they are off screen
+	if(y < -350.0f)
+		field.active[i] = 2;
+}
+
+/* Move every brick down by fall and settle the ones reaching the buckets: caught counts red and blue bricks */
+/* landing in their own bucket, blackcaught black bricks landing in either - bricks that miss stop being shootable */
+void fallBricks (BrickField &field, float fall, const Object2D &redbucket, const Object2D &bluebucket, int &caught, int &blackcaught)
+{
+	BucketEdge r = bucketEdge(redbucket), b = bucketEdge(bluebucket);
+	int n = field.size();
+	int i = 0;
+	caught = 0;
+	blackcaught = 0;
+#ifdef __SSE2__
+	// Four bricks at a time, with every branch of fallBrick turned into a lane mask
+	const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+	const __m128i red = _mm_set1_epi32(BRICK_RED), blue = _mm_set1_epi32(BRICK_BLUE), black = _mm_set1_epi32(BRICK_BLACK);
+	const __m128 fallv = _mm_set1_ps(fall), half = _mm_set1_ps(0.5f);
+	const __m128 bucketline = _mm_set1_ps(-240.0f), offscreen = _mm_set1_ps(-350.0f);
+	for (; i + 4 <= n; i += 4){
+		__m128i active = _mm_loadu_si128((__m128i*) &field.active[i]);
+		__m128 alive = _mm_castsi128_ps(_mm_xor_si128(_mm_cmpeq_epi32(active, two), _mm_set1_epi32(-1)));
+		__m128 y = _mm_sub_ps(_mm_loadu_ps(&field.y[i]), _mm_and_ps(fallv, alive));
+		_mm_storeu_ps(&field.y[i], y);
+
+		__m128 cross = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(active, one)), _mm_cmplt_ps(y, bucketline));
+		if(_mm_movemask_ps(cross)){
+			__m128 x = _mm_loadu_ps(&field.x[i]);
+			__m128 halfw = _mm_mul_ps(_mm_loadu_ps(&field.width[i]), half);
+			__m128 bottom = _mm_sub_ps(y, _mm_mul_ps(_mm_loadu_ps(&field.height[i]), half));
+			__m128 left = _mm_sub_ps(x, halfw), right = _mm_add_ps(x, halfw);
+			__m128 inred = _mm_and_ps(_mm_cmplt_ps(bottom, _mm_set1_ps(r.top)),
+				_mm_and_ps(_mm_cmplt_ps(right, _mm_set1_ps(r.right)), _mm_cmpgt_ps(left, _mm_set1_ps(r.left))));
+			__m128 inblue = _mm_and_ps(_mm_cmplt_ps(bottom, _mm_set1_ps(b.top)),
+				_mm_and_ps(_mm_cmplt_ps(right, _mm_set1_ps(b.right)), _mm_cmpgt_ps(left, _mm_set1_ps(b.left))));
+			__m128i kind = _mm_loadu_si128((__m128i*) &field.kind[i]);
+			__m128 isred = _mm_castsi128_ps(_mm_cmpeq_epi32(kind, red));
+			__m128 isblue = _mm_castsi128_ps(_mm_cmpeq_epi32(kind, blue));
+			__m128 isblack = _mm_castsi128_ps(_mm_cmpeq_epi32(kind, black));
+			__m128 caughtm = _mm_and_ps(cross, _mm_or_ps(_mm_and_ps(isred, inred), _mm_and_ps(isblue, inblue)));
+			__m128 blackm = _mm_and_ps(cross, _mm_and_ps(isblack, _mm_or_ps(inred, inblue)));
+			caught += __builtin_popcount(_mm_movemask_ps(caughtm));
+			blackcaught += __builtin_popcount(_mm_movemask_ps(blackm));
+			// Crossing lanes become 2 when caught and 0 when missed
+			__m128i settled = _mm_and_si128(_mm_castps_si128(_mm_or_ps(caughtm, blackm)), two);
+			active = _mm_or_si128(_mm_andnot_si128(_mm_castps_si128(cross), active), settled);
+		}
+		__m128i gone = _mm_castps_si128(_mm_cmplt_ps(y, offscreen));
+		active = _mm_or_si128(_mm_andnot_si128(gone, active), _mm_and_si128(gone, two));
+		_mm_storeu_si128((__m128i*) &field.active[i], active);
+	}
+#endif
+	for (; i < n; i++)
+		fallBrick(field, i, fall, r, b, caught, blackcaught);
+}
+
+void fallBricksScalar (BrickField &field, float fall, const Object2D &redbucket, const Object2D &bluebucket, int &caught, int &blackcaught)
+{
+	BucketEdge r = bucketEdge(redbucket), b = bucketEdge(bluebucket);
+	caught = 0;
+	blackcaught = 0;
+	for (int i = 0; i < field.size(); i++)
+		fallBrick(field, i, fall, r, b, caught, blackcaught);
+}
+void spawnBrick (GameInstance &game)
+{
+	TRACE_INSTANT("spawn");
+	float xcoord = randomBelow(game.spawnrng, 500) - 210;
+	int newcolor = randomBelow(game.spawnrng, 10) + 1;
+	int kind;
+	if(newcolor <= 4)
+		kind = BRICK_RED;
+	else if(newcolor <= 8)
+		kind = BRICK_BLUE;
+	else 
+		kind = BRICK_BLACK;
+	game.bricks.add(xcoord, 310.0, 10.0, 20.0, kind);
+}
+
+/* Uniform grid over the 800x600 playfield, rebuilt every tick, so a beam is only tested against the bricks near its tip */
+/* Cells are stored compactly: the bricks of cell c are cellbricks[cellstart[c]] to cellbricks[cellstart[c + 1] - 1] */
+const float GRID_CELL = 40.0;
+const int GRID_COLS = 800 / 40;
+const int GRID_ROWS = 600 / 40;
+
+static int gridColumn (float x)
+{
+	int col = (int) floor((x + 400.0) / GRID_CELL);
+	return col < 0 ? 0 : (col >= GRID_COLS ? GRID_COLS - 1 : col);
+}
+static int gridRow (float y)
+{
+	int row = (int) floor((y + 300.0) / GRID_CELL);
+	return row < 0 ? 0 : (row >= GRID_ROWS ? GRID_ROWS - 1 : row);
+}
+
+/* Bricks that can still be shot go into every cell their box overlaps - anything beyond the edge lands in the edge cells */
+static void buildBrickGrid (GameInstance &game)
+{
+	int n = game.bricks.size();
+	game.cellstart.assign(GRID_COLS * GRID_ROWS + 1, 0);
+	for (int pass = 0; pass < 2; pass++){
+		for (int i = 0; i < n; i++){
+			if(game.bricks.active[i] != 1)
+				continue;
+			float halfw = game.bricks.width[i]/2.0, halfh = game.bricks.height[i]/2.0;
+			int c0 = gridColumn(game.bricks.x[i] - halfw), c1 = gridColumn(game.bricks.x[i] + halfw);
+			int r0 = gridRow(game.bricks.y[i] - halfh), r1 = gridRow(game.bricks.y[i] + halfh);
+			for (int r = r0; r <= r1; r++)
+				for (int c = c0; c <= c1; c++){
+					if(pass == 0)
+						game.cellstart[r * GRID_COLS + c + 1] ++;
+					else
+						game.cellbricks[game.cellstart[r * GRID_COLS + c] ++] = i;
+				}
+		}
+		if(pass == 0){
+			// Turn counts into start offsets
+			for (int c = 1; c <= GRID_COLS * GRID_ROWS; c++)
+				game.cellstart[c] += game.cellstart[c - 1];
+			game.cellbricks.resize(game.cellstart[GRID_COLS * GRID_ROWS]);
+		}
+		else {
+			// Filling advanced every start to the next cell's start; shift back
+			for (int c = GRID_COLS * GRID_ROWS; c > 0; c--)
+				game.cellstart[c] = game.cellstart[c - 1];
+			game.cellstart[0] = 0;
+		}
+	}
+}
+
+/* Slab test of the segment p + t d, t in [0, 1], against a brick - returns the entry t, or -1 for a miss */
+static float segmentHitsBrick (const GameInstance &game, int i, float px, float py, float dx, float dy)
+{
+	float lo = 0.0, hi = 1.0;
+	float pos[2] = {px, py}, dir[2] = {dx, dy};
+	float bmin[2] = {game.bricks.x[i] - game.bricks.width[i]/2.0f, game.bricks.y[i] - game.bricks.height[i]/2.0f};
+	float bmax[2] = {game.bricks.x[i] + game.bricks.width[i]/2.0f, game.bricks.y[i] + game.bricks.height[i]/2.0f};
+	for (int k = 0; k < 2; k++){
+		if(fabs(dir[k]) < 1e-9){
+			if(pos[k] <= bmin[k] || pos[k] >= bmax[k])
+				return -1;
+			continue;
+		}
+		float t1 = (bmin[k] - pos[k])/dir[k], t2 = (bmax[k] - pos[k])/dir[k];
+		if(t1 > t2) swap(t1, t2);
+		lo = max(lo, t1);
+		hi = min(hi, t2);
+		if(lo > hi)
+			return -1;
+	}
+	return lo;
+}
+
+/* Narrow besthit and hit to the earliest brick crossed by the segment, among the candidates (or the first n bricks */
+/* when candidates is NULL) - on an exact tie the lowest index wins, so testing the bricks in any order or split */
+/* over any number of calls picks the same one */
+static void brickOnSegment (const GameInstance &game, float px, float py, float dx, float dy, const int *candidates, int n, float &besthit, int &hit)
+{
+	for (int e = 0; e < n; e++){
+		int i = candidates ? candidates[e] : e;
+		if(game.bricks.active[i] != 1)
+			continue;
+		float t = segmentHitsBrick(game, i, px, py, dx, dy);
+		if(t < 0 || t > besthit || (t == besthit && i > hit))
+			continue;
+		besthit = t;
+		hit = i;
+	}
+}
+
+/* Below this many brick-beam pairs, testing every pair is cheaper than building the grid */
+const int GRID_MIN_PAIRS = 256;
+
+/* Sweep the tip of every live beam over the stretch of its path it covered this tick, and stop it at the first brick in the way */
+void collideBeams (GameInstance &game)
+{
+	if(game.bricks.empty() || game.beam.empty())
+		return;
+	int usegrid = game.bricks.size() * game.beam.size() > GRID_MIN_PAIRS;
+	if(usegrid)
+		buildBrickGrid(game);
+	for (ObjectPool<Beam> :: iterator it1 = game.beam.begin(); it1 != game.beam.end(); it1++){
+		Beam &shot = *it1;
+		if(shot.active == 0)
+			continue;
+		int hit = -1;
+		for (int l = 0; l < shot.legs && hit < 0; l++){
+			float from = max(shot.prevtravelled, shot.pathlen[l]);
+			float to = min(shot.travelled, shot.pathlen[l + 1]);
+			if(from >= to)
+				continue;
+			float ca = shot.pathdx[l], sa = shot.pathdy[l];
+			float px = shot.pathx[l] + (from - shot.pathlen[l]) * ca;
+			float py = shot.pathy[l] + (from - shot.pathlen[l]) * sa;
+			float dx = (to - from) * ca, dy = (to - from) * sa;
+			float besthit = 2.0;
+			if(!usegrid)
+				brickOnSegment(game, px, py, dx, dy, NULL, game.bricks.size(), besthit, hit);
+			else {
+				// Every cell under the segment's bounding box - at 10 units a tick that is rarely more than one
+				int c0 = gridColumn(min(px, px + dx)), c1 = gridColumn(max(px, px + dx));
+				int r0 = gridRow(min(py, py + dy)), r1 = gridRow(max(py, py + dy));
+				for (int r = r0; r <= r1; r++)
+					for (int c = c0; c <= c1; c++){
+						int cell = r * GRID_COLS + c;
+						brickOnSegment(game, px, py, dx, dy, game.cellbricks.data() + game.cellstart[cell], game.cellstart[cell + 1] - game.cellstart[cell], besthit, hit);
+					}
+			}
+		}
+		if(hit < 0)
+			continue;
+		game.bricks.active[hit] = 2;
+		shot.active = 0;
+		if(game.bricks.kind[hit] == BRICK_BLACK)
+			game.totalscore += 10;
+		else {
+			game.life -= 1;
+			game.totalscore -= 5;
+			if(game.totalscore < 0)
+				game.totalscore = 0;
+			if(game.life == 0)
+				game.gameover = 1;
+		}
+	}
+}
+
+/* Advance the game by dt seconds - movement is specified per tick of 1/TICKS_PER_SECOND */
+void update (GameInstance &game, double dt)
+{
+	game.simticks ++;
+	if(game.gameover)
+		return;
+	TRACE_SCOPE("tick");
+	game.simtime += dt;
+	float steps = dt * TICKS_PER_SECOND;
+
+	// Remember the previous state so draw can interpolate between ticks
+	game.bricks.prevy = game.bricks.y;
+	for (ObjectPool<Beam> :: iterator it = game.beam.begin(); it != game.beam.end(); it++){
+		it->prevx = it->x;
+		it->prevy = it->y;
+	}
+
+	//Move bricks
+	int caught, blackcaught;
+	fallBricks(game.bricks, game.brickspeed * steps, game.buckets[game.redBucket], game.buckets[game.blueBucket], caught, blackcaught);
+	game.totalscore += 10 * caught;
+	if(blackcaught)
+		game.gameover = 1;
+	//Move beams along their paths
+	for (ObjectPool<Beam> :: iterator it1 = game.beam.begin(); it1 != game.beam.end(); it1++){
+		if(it1->active == 0) continue;
+		it1->prevtravelled = it1->travelled;
+		it1->travelled += BEAM_SPEED * steps;
+		placeBeam(*it1);
+	}
+	collideBeams(game);
+	// Beams that did not hit a brick die at the end of their path
+	for (ObjectPool<Beam> :: iterator it1 = game.beam.begin(); it1 != game.beam.end(); it1++){
+		if(it1->legs == 0 || it1->travelled >= it1->pathlen[it1->legs])
+			it1->active = 0;
+	}
+	// Dead bricks and beams give their slots back for the next spawn
+	game.bricks.reclaim(2);
+	reclaimObjects(game.beam, 0);
+
+	if(game.simtime - game.last_beam_time >= 1.0)
+		game.gunparts[game.gunArm].active = 0;
+	if(game.simtime - game.last_spawn_time >= (2.0 - game.brickspeed * 0.25)){ // atleast 0.5s elapsed since last spawn
+		spawnBrick(game);
+		game.last_spawn_time = game.simtime;
+	}
+}
+
+const char *actionNames[NUM_ACTIONS] = {
+	"none", "tiltup", "tiltdown", "up", "down", "fire",
+	"redleft", "redright", "blueleft", "blueright", "faster", "slower"
+};
+
+void applyAction (GameInstance &game, int act)
+{
+	if(game.inputlocked)
+		return;
+	recordEvent(game, EV_ACTION, act, 0);
+	switch (act) {
+		case ACT_TILT_UP:
+		tiltGunUporDown(game, 1);
+		break;
+		case ACT_TILT_DOWN:
+		tiltGunUporDown(game, -1);
+		break;
+		case ACT_GUN_UP:
+		moveGunUporDown(game, 1);
+		break;
+		case ACT_GUN_DOWN:
+		moveGunUporDown(game, -1);
+		break;
+		case ACT_FIRE:
+		firegun(game);
+		break;
+		case ACT_RED_LEFT:
+		moveBucket(game, 0, -1);
+		break;
+		case ACT_RED_RIGHT:
+		moveBucket(game, 0, 1);
+		break;
+		case ACT_BLUE_LEFT:
+		moveBucket(game, 1, -1);
+		break;
+		case ACT_BLUE_RIGHT:
+		moveBucket(game, 1, 1);
+		break;
+		case ACT_FASTER:
+		if(game.brickspeed < 7.0)
+			game.brickspeed ++;
+		break;
+		case ACT_SLOWER:
+		if(game.brickspeed > 1.0)
+			game.brickspeed --;
+		break;
+		default:
+		break;
+	}
+}
+
+/* Mouse input sets positions and angles outright rather than stepping them */
+void setBucketX (GameInstance &game, int color, float x)
+{
+	Object2D &bucket = game.buckets[color == 0 ? game.redBucket : game.blueBucket];
+	if(game.inputlocked || bucket.x == x)
+		return;
+	recordEvent(game, EV_BUCKET_X, color, x);
+	bucket.x = x;
+}
+void setGunY (GameInstance &game, float y)
+{
+	if(game.inputlocked || y > 200.0 || y < -150.0 || game.gunparts[game.gunArm].y == y)
+		return;
+	recordEvent(game, EV_GUN_Y, 0, y);
+	for (ObjectPool<Object2D> :: iterator it = game.gunparts.begin(); it != game.gunparts.end(); it++)
+		it->y = y;
+}
+void aimGun (GameInstance &game, float angle)
+{
+	if(game.inputlocked)
+		return;
+	recordEvent(game, EV_AIM, 0, angle);
+	setAngle(game.gunparts[game.gunArm], angle);
+	setAngle(game.gunparts[game.gunBase2], angle + 45.0);
+}
+
+/* Create the fixed objects of the playfield in a new instance and start its first game, with bricks spawned from seed */
+void initGame (GameInstance &game, unsigned int seed)
+{
+	seedRandom(game.spawnrng, seed);
+	game.simtime = 0.0;
+	game.simticks = 0;
+	game.last_beam_time = 0.0;
+	game.last_spawn_time = 0.0;
+	game.inputlocked = 0;
+	game.recording = NULL;
+	//Buckets
+	game.redBucket = createRectangle (game.buckets, red, 0.0, 200.0, -275.0, 50.0, 100.0);
+	game.blueBucket = createRectangle (game.buckets, blue, 0.0, -200.0, -275.0, 50.0, 100.0);
+	//Cannons
+	game.gunArm = createRectangle (game.gunparts, black, 0.0, 0, 0, 10.0, 150.0);
+	game.gunBase1 = createRectangle (game.gunparts, black, 0.0, 0, 0, 75.0, 75.0);
+	game.gunBase2 = createRectangle (game.gunparts, black, 45.0, 0, 0, 75.0, 75.0);
+	//Mirrors
+	createRectangle (game.mirrors, grey, 135.0, 0, 135.0, 3.0, 50.0);
+	createRectangle (game.mirrors, black, 135.0, 2.0, 137.0, 2.0, 50.0);
+	createRectangle (game.mirrors, grey, 45.0, 165.0, 70.0, 3.0, 50.0);
+	createRectangle (game.mirrors, black, 45.0, 167.0, 68.0, 2.0, 50.0);
+	createRectangle (game.mirrors, grey, 45.0, 165.0, -135.0, 3.0, 50.0);
+	createRectangle (game.mirrors, black, 45.0, 167.0, -137.0, 2.0, 50.0);
+	createRectangle (game.mirrors, grey, 315.0, -110.0, -25.0, 3.0, 50.0);
+	createRectangle (game.mirrors, black, 315.0, -112.0, -27.0, 2.0, 50.0);
+
+	game.brickspeed = 1.0;
+	game.totalscore = 0;
+	game.life = 3;
+	game.gameover = 0;
+}
+/* Start a fresh game, destroying everything spawned by the previous one */
+void resetGame (GameInstance &game)
+{
+	game.bricks.clear();
+	for (int i = game.beam.size() - 1; i >= 0; i--)
+		destroyRectangle(game.beam, game.beam.handleAt(i));
+	game.gunparts[game.gunArm].active = 0;
+	game.totalscore = 0;
+	game.life = 3;
+	game.gameover = 0;
+}
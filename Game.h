@@ -0,0 +1,137 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <cstdio>
+#include <vector>
+
+#include "ObjectPool.h"
+#include "BrickField.h"
+#include "Random.h"
+
+/* Game state and simulation - no windowing or GL, shared by the game, the headless simulator and the tools */
+/* Every function that reads or changes a game takes its GameInstance first */
+
+struct color{
+	float r, g, b;
+};
+typedef struct color color;
+bool operator==(const color& lhs, const color& rhs);
+
+struct Object2D {
+	float x, y;
+	float prevx, prevy;
+	float height, width;
+	float angle;
+	float dirx, diry;	// unit vector along angle, kept in step by setAngle
+	color objcolor;
+	int active;
+};
+typedef struct Object2D Object2D;
+
+/* What a brick scores is decided by its kind - its color is only for drawing */
+enum brickKind { BRICK_RED, BRICK_BLUE, BRICK_BLACK, NUM_BRICK_KINDS };
+
+/* A laser's whole path is traced when it is fired, so a tick only moves its tip along the precomputed legs */
+const int MAX_BEAM_BOUNCES = 16;
+const float BEAM_SPEED = 10.0;
+const float BEAM_TIP = 15.0;
+
+struct Beam : Object2D {
+	float pathx[MAX_BEAM_BOUNCES + 2], pathy[MAX_BEAM_BOUNCES + 2];
+	float pathangle[MAX_BEAM_BOUNCES + 1];
+	float pathdx[MAX_BEAM_BOUNCES + 1], pathdy[MAX_BEAM_BOUNCES + 1];
+	float pathlen[MAX_BEAM_BOUNCES + 2];	// distance along the path to the start of each leg
+	int legs;
+	int leg;
+	float travelled, prevtravelled;
+};
+typedef struct Beam Beam;
+
+extern color red;
+extern color blue;
+extern color black;
+extern color grey;
+extern color green;	// the life markers - despite the name, purple
+extern color yellow;
+extern color brickColors[NUM_BRICK_KINDS];
+
+/* Everything one game owns - games share nothing, so any number of them can be stepped side by side in one process */
+struct GameInstance {
+	BrickField bricks;
+	ObjectPool<Object2D> gunparts;
+	ObjectPool<Beam> beam;
+	ObjectPool<Object2D> mirrors;
+	ObjectPool<Object2D> buckets;
+
+	Handle redBucket, blueBucket;
+	Handle gunArm, gunBase1, gunBase2;
+
+	int brickspeed;
+	int totalscore;
+	double last_beam_time;
+	int life;
+	int gameover;
+	double simtime;
+	double last_spawn_time;
+	Random spawnrng;	// decides where bricks spawn and their kind
+	long simticks;		// ticks run since initGame
+	int inputlocked;	// set while a replay drives the game, so live input is ignored
+	FILE *recording;	// where inputs are logged, NULL when not recording
+
+	// Brick grid for collideBeams, kept between ticks so its storage is reused
+	std::vector<int> cellstart, cellbricks;
+};
+typedef struct GameInstance GameInstance;
+
+/* Simulation runs in fixed ticks, independent of how often frames are drawn */
+const double TICKS_PER_SECOND = 60.0;
+const double TICK = 1.0/TICKS_PER_SECOND;
+
+Handle createRectangle (ObjectPool<Object2D> &objclass, color objcolor, float angle, float x, float y, float height, float width);
+void setAngle (Object2D &obj, float angle);
+
+template <typename T>
+void destroyRectangle (ObjectPool<T> &objclass, Handle h)
+{
+	if (!objclass.valid(h))
+		return;
+	objclass.remove(h);
+}
+/* Destroy every object of the class whose active flag equals deadstate */
+template <typename T>
+void reclaimObjects (ObjectPool<T> &objclass, int deadstate)
+{
+	// Walk backwards so the object swapped into a hole has already been checked
+	for (int i = objclass.size() - 1; i >= 0; i--){
+		if (objclass.begin()[i].active == deadstate)
+			destroyRectangle(objclass, objclass.handleAt(i));
+	}
+}
+
+void moveGunUporDown(GameInstance &game, int dir);
+void tiltGunUporDown(GameInstance &game, int dir);
+void moveBucket(GameInstance &game, int color, int dir);
+void traceBeam (GameInstance &game, Beam &shot, float x, float y, float angle, float dx, float dy);
+void placeBeam (Beam &shot);
+void firegun(GameInstance &game);
+int bottomCollision (Object2D a, Object2D b);
+void fallBricks (BrickField &field, float fall, const Object2D &redbucket, const Object2D &bluebucket, int &caught, int &blackcaught);
+/* The same, one brick at a time with no SIMD - the reference fallBricks is checked against */
+void fallBricksScalar (BrickField &field, float fall, const Object2D &redbucket, const Object2D &bluebucket, int &caught, int &blackcaught);
+
+/* Discrete player actions, so input can come from scripts or random policies as well as the keyboard */
+enum action { ACT_NONE, ACT_TILT_UP, ACT_TILT_DOWN, ACT_GUN_UP, ACT_GUN_DOWN, ACT_FIRE,
+	ACT_RED_LEFT, ACT_RED_RIGHT, ACT_BLUE_LEFT, ACT_BLUE_RIGHT, ACT_FASTER, ACT_SLOWER, NUM_ACTIONS };
+extern const char *actionNames[NUM_ACTIONS];
+void applyAction (GameInstance &game, int act);
+void setBucketX (GameInstance &game, int color, float x);
+void setGunY (GameInstance &game, float y);
+void aimGun (GameInstance &game, float angle);
+
+void initGame (GameInstance &game, unsigned int seed);
+void resetGame (GameInstance &game);
+void spawnBrick (GameInstance &game);
+void collideBeams (GameInstance &game);
+void update (GameInstance &game, double dt);
+
+#endif
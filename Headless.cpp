@@ -0,0 +1,179 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <time.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Game.h"
+#include "Replay.h"
+#include "Parallel.h"
+
+using namespace std;
+
+/* Runs the game with no window or GL context, for simulating many games on machines without a GPU */
+/* Input is either random or read from a script of "<tick> <action>" lines; a batch of games is spread over every core */
+
+struct ScriptedAction {
+	long tick;
+	int act;
+};
+typedef struct ScriptedAction ScriptedAction;
+
+int loadScript (const char *path, vector<ScriptedAction> &script)
+{
+	ifstream in(path);
+	if (!in.is_open()){
+		fprintf(stderr, "headless: cannot open script %s\n", path);
+		return 0;
+	}
+	long tick;
+	string name;
+	while (in >> tick >> name){
+		int act;
+		for (act = 0; act < NUM_ACTIONS; act++)
+			if (name == actionNames[act])
+				break;
+		if (act == NUM_ACTIONS){
+			fprintf(stderr, "headless: unknown action %s at tick %ld\n", name.c_str(), tick);
+			return 0;
+		}
+		ScriptedAction sa = {tick, act};
+		script.push_back(sa);
+	}
+	return 1;
+}
+
+/* Re-run a session recorded by the game with --record, as fast as possible */
+int replaySession (const char *path)
+{
+	Replay replay;
+	if (!loadReplay(path, replay))
+		return 1;
+	GameInstance game;
+	initGame(game, replay.seed);
+	game.inputlocked = 1;
+	size_t next = 0;
+	clock_t start = clock();
+	while (game.simticks < replay.length){
+		playReplayEvents(game, replay, next, game.simticks);
+		update(game, TICK);
+	}
+	double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	printf("replay: score %d, lives %d, ticks %ld%s, %.0f ticks/s (seed %u)\n", game.totalscore, game.life, game.simticks,
+		game.gameover ? ", game over" : "", seconds > 0 ? game.simticks / seconds : 0.0, replay.seed);
+	return 0;
+}
+
+/* How one game of a batch ended */
+struct GameResult {
+	int score;
+	int life;
+	int gameover;
+	long ticks;
+};
+typedef struct GameResult GameResult;
+
+/* Play game number index of a batch until it is over or has run for ticks ticks, with the script's actions or random */
+/* ones when script is NULL. Each game is seeded from the batch seed and its index alone, so its result is the same */
+/* whichever thread plays it and whatever else runs alongside */
+GameResult playGame (unsigned int seed, int index, long ticks, const vector<ScriptedAction> *script)
+{
+	GameInstance game;
+	initGame(game, seed + index);
+	// The random policy draws from its own generator, seeded independently of the game's, so the bricks depend only on the seed
+	Random policy;
+	seedRandom(policy, (1ULL << 32) + seed + index);
+
+	size_t next = 0;
+	long t;
+	for (t = 0; t < ticks && !game.gameover; t++){
+		if (script){
+			while (next < script->size() && (*script)[next].tick <= t)
+				applyAction(game, (*script)[next++].act);
+		}
+		else
+			applyAction(game, randomBelow(policy, NUM_ACTIONS));
+		update(game, TICK);
+	}
+	GameResult result = {game.totalscore, game.life, game.gameover, t};
+	return result;
+}
+
+static int usage (const char *program)
+{
+	fprintf(stderr, "usage: %s [--ticks N] [--games N] [--threads N] [--seed N] [--script FILE] [--replay FILE] [--quiet]\n", program);
+	return 1;
+}
+
+int main (int argc, char** argv)
+{
+	long ticks = 60 * 60 * 5;
+	int games = 1;
+	int threads = max(1u, thread::hardware_concurrency());	// 0 when the core count is unknown
+	unsigned int seed = time(NULL);
+	const char *scriptpath = NULL;
+	const char *replaypath = NULL;
+	int quiet = 0;
+
+	for (int i = 1; i < argc; i++){
+		string arg = argv[i];
+		if (arg == "--ticks" && i + 1 < argc)
+			ticks = atol(argv[++i]);
+		else if (arg == "--games" && i + 1 < argc)
+			games = atoi(argv[++i]);
+		else if (arg == "--threads" && i + 1 < argc)
+			threads = atoi(argv[++i]);
+		else if (arg == "--seed" && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 10);
+		else if (arg == "--script" && i + 1 < argc)
+			scriptpath = argv[++i];
+		else if (arg == "--replay" && i + 1 < argc)
+			replaypath = argv[++i];
+		else if (arg == "--quiet")
+			quiet = 1;
+		else
+			return usage(argv[0]);
+	}
+	if (games < 1)
+		return usage(argv[0]);
+
+	if (replaypath)
+		return replaySession(replaypath);
+
+	vector<ScriptedAction> script;
+	if (scriptpath && !loadScript(scriptpath, script))
+		return 1;
+
+	vector<GameResult> results(games);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parallelFor(games, threads, [&] (int g) {
+		results[g] = playGame(seed, g, ticks, scriptpath ? &script : NULL);
+	});
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	long totalticks = 0;
+	long scoresum = 0, lifesum = 0;
+	int minscore = 0, maxscore = 0, over = 0;
+	for (int g = 0; g < games; g++){
+		const GameResult &r = results[g];
+		totalticks += r.ticks;
+		scoresum += r.score;
+		lifesum += r.life;
+		over += r.gameover;
+		if (g == 0 || r.score < minscore)
+			minscore = r.score;
+		if (g == 0 || r.score > maxscore)
+			maxscore = r.score;
+		if (!quiet)
+			printf("game %d: score %d, lives %d, ticks %ld%s\n", g, r.score, r.life, r.ticks, r.gameover ? ", game over" : "");
+	}
+	printf("%d games, %ld ticks, mean score %.2f (%d to %d), mean lives %.2f, %d over, %.0f ticks/s on %d threads (seed %u)\n",
+		games, totalticks, (double) scoresum / games, minscore, maxscore, (double) lifesum / games, over,
+		seconds > 0 ? totalticks / seconds : 0.0, threads < games ? threads : games, seed);
+	return 0;
+}
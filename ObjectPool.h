@@ -0,0 +1,92 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <vector>
+#include <cstddef>
+
+/* Handle to an object stored in an ObjectPool */
+/* The generation is bumped every time a slot is freed, so a handle to a removed object never aliases its replacement */
+struct Handle {
+	int index;
+	unsigned int generation;
+};
+typedef struct Handle Handle;
+
+const Handle NullHandle = {-1, 0};
+
+/* Objects live in one contiguous array, so walking a pool is a linear scan */
+/* Handles go through a slot table to find the object's current position in that array */
+template <typename T>
+class ObjectPool {
+public:
+	typedef T* iterator;
+
+	Handle add (const T& obj)
+	{
+		int slot;
+		if (!freeslots.empty()) {
+			slot = freeslots.back();
+			freeslots.pop_back();
+		}
+		else {
+			slot = slots.size();
+			Slot s = {0, 0};
+			slots.push_back(s);
+		}
+		slots[slot].dense = dense.size();
+		dense.push_back(obj);
+		densetoslot.push_back(slot);
+		Handle h = {slot, slots[slot].generation};
+		return h;
+	}
+
+	/* Swap the last object into the hole, so the array stays packed */
+	void remove (Handle h)
+	{
+		if (!valid(h))
+			return;
+		int hole = slots[h.index].dense;
+		int last = dense.size() - 1;
+		if (hole != last) {
+			dense[hole] = dense[last];
+			densetoslot[hole] = densetoslot[last];
+			slots[densetoslot[hole]].dense = hole;
+		}
+		dense.pop_back();
+		densetoslot.pop_back();
+		slots[h.index].generation ++;
+		freeslots.push_back(h.index);
+	}
+
+	bool valid (Handle h) const
+	{
+		return h.index >= 0 && h.index < (int) slots.size() && slots[h.index].generation == h.generation;
+	}
+
+	T& operator[] (Handle h) { return dense[slots[h.index].dense]; }
+	const T& operator[] (Handle h) const { return dense[slots[h.index].dense]; }
+
+	/* Handle of the object currently stored at position i of the dense array */
+	Handle handleAt (int i) const
+	{
+		Handle h = {densetoslot[i], slots[densetoslot[i]].generation};
+		return h;
+	}
+
+	iterator begin () { return dense.empty() ? NULL : &dense[0]; }
+	iterator end () { return begin() + dense.size(); }
+	int size () const { return dense.size(); }
+	bool empty () const { return dense.empty(); }
+
+private:
+	struct Slot {
+		int dense;
+		unsigned int generation;
+	};
+	std::vector<T> dense;
+	std::vector<int> densetoslot;
+	std::vector<Slot> slots;
+	std::vector<int> freeslots;
+};
+
+#endif
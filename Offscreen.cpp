@@ -0,0 +1,105 @@
+#include <cstdio>
+#include <vector>
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "Offscreen.h"
+
+using namespace std;
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static GLuint framebuffer;
+static GLuint renderbuffers[2];	// color, depth
+
+/* The surfaceless platform needs no display server; fall back to the default display where Mesa lacks it */
+static EGLDisplay openDisplay ()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay d = EGL_NO_DISPLAY;
+	if (getPlatformDisplay)
+		d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (d == EGL_NO_DISPLAY)
+		d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	return d;
+}
+
+int initOffscreen (int width, int height)
+{
+	display = openDisplay();
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)){
+		fprintf(stderr, "offscreen: no EGL display\n");
+		return 0;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)){
+		fprintf(stderr, "offscreen: EGL %d.%d has no desktop OpenGL\n", major, minor);
+		return 0;
+	}
+	// Same version and profile as the window asks GLFW for; no surface, so no config is needed
+	const EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)){
+		fprintf(stderr, "offscreen: cannot create a surfaceless OpenGL 3.3 core context\n");
+		return 0;
+	}
+	if (!gladLoadGLLoader((GLADloadproc) eglGetProcAddress)){
+		fprintf(stderr, "offscreen: cannot load OpenGL\n");
+		return 0;
+	}
+
+	// With no surface there is no default framebuffer, so everything is drawn into this one
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+		fprintf(stderr, "offscreen: framebuffer incomplete\n");
+		return 0;
+	}
+	return 1;
+}
+
+int saveFrame (const char *path, int width, int height)
+{
+	vector<unsigned char> pixels((size_t) width * height * 3);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+	FILE *out = fopen(path, "wb");
+	if (!out)
+		return 0;
+	fprintf(out, "P6\n%d %d\n255\n", width, height);
+	// GL's rows start at the bottom
+	for (int y = height - 1; y >= 0; y--)
+		fwrite(&pixels[(size_t) y * width * 3], 1, width * 3, out);
+	fclose(out);
+	return 1;
+}
+
+void closeOffscreen ()
+{
+	if (context != EGL_NO_CONTEXT){
+		glDeleteRenderbuffers(2, renderbuffers);
+		glDeleteFramebuffers(1, &framebuffer);
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		context = EGL_NO_CONTEXT;
+	}
+	if (display != EGL_NO_DISPLAY){
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+	}
+}
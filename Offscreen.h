@@ -0,0 +1,14 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+/* GL context with no window or display server, for rendering on machines without a GPU or X - an EGL context on */
+/* Mesa's surfaceless platform (llvmpipe when there is no GPU) drawing into a framebuffer object */
+/* Only built with -DOFFSCREEN (make -f Makefile.linux sample2D_offscreen) */
+
+/* Create the context and a width x height framebuffer, make both current and load GL - returns 0 on failure */
+int initOffscreen (int width, int height);
+/* Write the framebuffer to path as a binary PPM, top row first - returns 0 if it cannot be written */
+int saveFrame (const char *path, int width, int height);
+void closeOffscreen ();
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Work-stealing loop over independent tasks, for running many games at once */
+
+/* The indices a worker has yet to run - it takes them from the front, thieves from the back */
+struct WorkRange {
+	std::mutex lock;
+	int begin, end;
+};
+typedef struct WorkRange WorkRange;
+
+/* Take the next index of a range, or -1 when it is empty */
+inline int takeWork (WorkRange &r)
+{
+	std::lock_guard<std::mutex> guard(r.lock);
+	return r.begin < r.end ? r.begin++ : -1;
+}
+
+/* Move the back half of the fullest other range into ranges[self], returning 0 when there is nothing left to steal */
+inline int stealWork (std::vector<WorkRange> &ranges, int self)
+{
+	for (;;){
+		int victim = -1, most = 0;
+		for (int v = 0; v < (int) ranges.size(); v++){
+			if (v == self)
+				continue;
+			std::lock_guard<std::mutex> guard(ranges[v].lock);
+			if (ranges[v].end - ranges[v].begin > most){
+				most = ranges[v].end - ranges[v].begin;
+				victim = v;
+			}
+		}
+		if (victim < 0)
+			return 0;
+		int from, to;
+		{
+			std::lock_guard<std::mutex> guard(ranges[victim].lock);
+			int left = ranges[victim].end - ranges[victim].begin;
+			// The victim may have run its range down since it was picked
+			if (left <= 0)
+				continue;
+			to = ranges[victim].end;
+			from = to - (left + 1) / 2;
+			ranges[victim].end = from;
+		}
+		std::lock_guard<std::mutex> guard(ranges[self].lock);
+		ranges[self].begin = from;
+		ranges[self].end = to;
+		return 1;
+	}
+}
+
+/* Run task(i) for every i from 0 to n - 1 on up to threads threads, the calling thread included, and return when all */
+/* are done. Each thread starts with an equal share of the indices; one that finishes early steals from the others, */
+/* so tasks of very different lengths - games that end after a few seconds or run to the tick limit - still keep */
+/* every thread busy. Tasks must not touch each other's state. */
+template <typename Task>
+void parallelFor (int n, int threads, Task task)
+{
+	if (threads > n)
+		threads = n;
+	if (threads < 1)
+		threads = 1;
+	std::vector<WorkRange> ranges(threads);
+	for (int w = 0; w < threads; w++){
+		ranges[w].begin = (long long) n * w / threads;
+		ranges[w].end = (long long) n * (w + 1) / threads;
+	}
+	auto worker = [&ranges, &task] (int self) {
+		for (;;){
+			int i = takeWork(ranges[self]);
+			if (i < 0){
+				if (!stealWork(ranges, self))
+					return;
+				continue;
+			}
+			task(i);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (int w = 1; w < threads; w++)
+		pool.push_back(std::thread(worker, w));
+	worker(0);
+	for (size_t w = 0; w < pool.size(); w++)
+		pool[w].join();
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/* Per-frame timings of the stages of the main loop, kept for the last PROFILE_FRAMES frames */
+/* Only built with -DPROFILE (make sample2D_profile) - otherwise PROFILE_SCOPE and PROFILE_END_FRAME expand to nothing */
+
+#include "Trace.h"
+
+enum profileStage { STAGE_UPDATE, STAGE_DRAW, STAGE_SWAP, STAGE_EVENTS, NUM_STAGES };
+const int PROFILE_FRAMES = 120;
+
+#ifdef PROFILE
+
+#include <chrono>
+#include <cstring>
+
+const char *const stageNames[NUM_STAGES] = {"update", "draw", "swap", "events"};
+
+struct FrameTimes {
+	long long cpu[NUM_STAGES];	// nanoseconds spent in each stage
+	long long gpu;			// nanoseconds the GPU spent on the frame's draw calls, -1 until known
+};
+typedef struct FrameTimes FrameTimes;
+
+/* Ring of the most recent frames - frames[current] is the one being recorded */
+struct Profiler {
+	FrameTimes frames[PROFILE_FRAMES];
+	int current;
+	long long frameno;
+};
+typedef struct Profiler Profiler;
+
+inline Profiler &profiler ()
+{
+	static Profiler p = {};
+	return p;
+}
+
+inline long long profileNow ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Adds the time from its construction to the end of its scope to a stage of the current frame, and to the trace */
+class ProfileScope {
+public:
+	ProfileScope (int stage) : stage(stage), start(profileNow()) {}
+	~ProfileScope ()
+	{
+		long long end = profileNow();
+		profiler().frames[profiler().current].cpu[stage] += end - start;
+		traceEvent(stageNames[stage], 'X', start, end - start);
+	}
+private:
+	int stage;
+	long long start;
+};
+
+/* Close the current frame and start recording the next one in the oldest slot */
+inline void profileEndFrame ()
+{
+	Profiler &p = profiler();
+	p.current = (p.current + 1) % PROFILE_FRAMES;
+	p.frameno ++;
+	memset(&p.frames[p.current], 0, sizeof(FrameTimes));
+	p.frames[p.current].gpu = -1;
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profilescope, __LINE__)(stage)
+#define PROFILE_END_FRAME() profileEndFrame()
+
+#else
+
+#define PROFILE_SCOPE(stage)
+#define PROFILE_END_FRAME()
+
+#endif
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+/* Small, fast random number generator (PCG32) with all of its state in one struct, so every game */
+/* can own an independently seeded stream rather than sharing the C library's rand() */
+struct Random {
+	unsigned long long state;
+	unsigned long long inc;
+};
+typedef struct Random Random;
+
+inline unsigned int nextRandom (Random &r)
+{
+	unsigned long long old = r.state;
+	r.state = old * 6364136223846793005ULL + r.inc;
+	unsigned int xorshifted = ((old >> 18) ^ old) >> 27;
+	unsigned int rot = old >> 59;
+	return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+inline void seedRandom (Random &r, unsigned long long seed)
+{
+	r.state = 0;
+	r.inc = 1;	// must be odd - one stream is enough, the seed picks the start
+	nextRandom(r);
+	r.state += seed;
+	nextRandom(r);
+}
+
+/* Uniform in 0 to n - 1, by scaling rather than %, which is faster - the bias is the same tiny one % has, for n far below 2^32 */
+inline int randomBelow (Random &r, int n)
+{
+	return (int) (((unsigned long long) nextRandom(r) * n) >> 32);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+#include "Game.h"
+#include "Digits.h"
+#include "Raster.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+/* A rectangle in playfield coordinates, placed the way the vertex shader places the unit square */
+struct RasterRect {
+	float x, y;
+	float halfw, halfh;
+	float cosangle, sinangle;
+	unsigned int rgb;	// red in the low byte
+};
+typedef struct RasterRect RasterRect;
+
+const unsigned int BACKGROUND = 0xffffff;
+
+static unsigned int packColor (color c)
+{
+	return (unsigned int) (c.r * 255.0f + 0.5f) | (unsigned int) (c.g * 255.0f + 0.5f) << 8 | (unsigned int) (c.b * 255.0f + 0.5f) << 16;
+}
+
+static void addRect (vector<RasterRect> &rects, float x, float y, float width, float height, float cosangle, float sinangle, color c)
+{
+	RasterRect r = {x, y, width/2.0f, height/2.0f, cosangle, sinangle, packColor(c)};
+	rects.push_back(r);
+}
+
+static void addText (vector<RasterRect> &rects, const char *text, float x, float y, int align)
+{
+	layoutText(text, x, y, 1.0, align, [&] (float sx, float sy, float width, float height) {
+		addRect(rects, sx, sy, width, height, 1.0, 0.0, black);
+	});
+}
+
+/* Everything draw() shows of the game, in the same order so later rectangles cover earlier ones */
+static void collectRects (GameInstance &game, vector<RasterRect> &rects)
+{
+	rects.clear();
+	if(game.gameover){
+		addText(rects, GAMEOVER_TEXT, 0.0, 0.0, ALIGN_CENTRE);
+		return;
+	}
+	BrickField &bricks = game.bricks;
+	for (int i = 0; i < bricks.size(); i++){
+		if(bricks.active[i] == 2) continue;
+		addRect(rects, bricks.x[i], bricks.y[i], bricks.width[i], bricks.height[i], 1.0, 0.0, brickColors[bricks.kind[i]]);
+	}
+	for (ObjectPool<Beam> :: iterator it = game.beam.begin(); it != game.beam.end(); it++){
+		if(it->active == 0) continue;
+		addRect(rects, it->x, it->y, it->width, it->height, it->dirx, it->diry, it->objcolor);
+	}
+	for (ObjectPool<Object2D> :: iterator it = game.mirrors.begin(); it != game.mirrors.end(); it++)
+		addRect(rects, it->x, it->y, it->width, it->height, it->dirx, it->diry, it->objcolor);
+	for (ObjectPool<Object2D> :: iterator it = game.buckets.begin(); it != game.buckets.end(); it++)
+		addRect(rects, it->x, it->y, it->width, it->height, 1.0, 0.0, it->objcolor);
+	for (ObjectPool<Object2D> :: iterator it = game.gunparts.begin(); it != game.gunparts.end(); it++)
+		addRect(rects, -375.0 + it->x, it->y, it->width, it->height, it->dirx, it->diry, it->objcolor);
+
+	char score[16];
+	snprintf(score, sizeof(score), "%d", game.totalscore);
+	addText(rects, score, SCORE_X, SCORE_Y, ALIGN_RIGHT);
+	float diag = sqrt(0.5f);
+	for (int l = 0; l < 3 && (l == 0 || l < game.life); l++)
+		addRect(rects, LIFE_X[l], LIFE_Y, LIFE_SIZE, LIFE_SIZE, diag, diag, green);
+}
+
+/* Fill every pixel of the frame whose centre lies inside r - pixel (px, py) has its centre at */
+/* (-400 + (px + 0.5) sx, 300 - (py + 0.5) sy), where sx and sy are the playfield units per pixel */
+static void fillRect (unsigned int *frame, int width, int height, const RasterRect &r)
+{
+	float sx = 800.0f / width, sy = 600.0f / height;
+	// Anything thinner than a pixel is widened to one, so beams still show at low resolutions
+	float halfw = max(r.halfw, 0.5f * sx), halfh = max(r.halfh, 0.5f * sy);
+	float c = r.cosangle, s = r.sinangle;
+	float ex = fabs(c) * halfw + fabs(s) * halfh, ey = fabs(s) * halfw + fabs(c) * halfh;
+	int px0 = max(0, (int) ceil((r.x - ex + 400.0f) / sx - 0.5f));
+	int px1 = min(width - 1, (int) floor((r.x + ex + 400.0f) / sx - 0.5f));
+	int py0 = max(0, (int) ceil((300.0f - r.y - ey) / sy - 0.5f));
+	int py1 = min(height - 1, (int) floor((300.0f - r.y + ey) / sy - 0.5f));
+	if(px0 > px1 || py0 > py1)
+		return;
+
+	// Bricks, buckets and digits cover their whole bounding box
+	if(s == 0.0f){
+		for (int py = py0; py <= py1; py++)
+			fill(frame + py * width + px0, frame + py * width + px1 + 1, r.rgb);
+		return;
+	}
+
+	// Otherwise test each pixel in the rectangle's own axes: u along its width, v along its height
+#ifdef __SSE2__
+	const __m128 cv = _mm_set1_ps(c), sv = _mm_set1_ps(s);
+	const __m128 hw = _mm_set1_ps(halfw), hh = _mm_set1_ps(halfh);
+	const __m128 absmask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 steps = _mm_mul_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(sx));
+	const __m128i rgb = _mm_set1_epi32(r.rgb);
+#endif
+	for (int py = py0; py <= py1; py++){
+		float dy = 300.0f - (py + 0.5f) * sy - r.y;
+		unsigned int *row = frame + py * width;
+		int px = px0;
+#ifdef __SSE2__
+		// Four pixels at a time, a coverage mask selecting the color for the lanes inside and the old pixel for the rest
+		const __m128 dys = _mm_set1_ps(dy * s), dyc = _mm_set1_ps(dy * c);
+		for (; px + 4 <= px1 + 1; px += 4){
+			__m128 dx = _mm_add_ps(_mm_set1_ps(-400.0f + (px + 0.5f) * sx - r.x), steps);
+			__m128 u = _mm_add_ps(_mm_mul_ps(dx, cv), dys);
+			__m128 v = _mm_sub_ps(dyc, _mm_mul_ps(dx, sv));
+			__m128i inside = _mm_castps_si128(_mm_and_ps(_mm_cmple_ps(_mm_and_ps(u, absmask), hw),
+				_mm_cmple_ps(_mm_and_ps(v, absmask), hh)));
+			__m128i old = _mm_loadu_si128((__m128i*) (row + px));
+			_mm_storeu_si128((__m128i*) (row + px), _mm_or_si128(_mm_and_si128(inside, rgb), _mm_andnot_si128(inside, old)));
+		}
+#endif
+		for (; px <= px1; px++){
+			float dx = -400.0f + (px + 0.5f) * sx - r.x;
+			float u = dx * c + dy * s, v = dy * c - dx * s;
+			if(fabs(u) <= halfw && fabs(v) <= halfh)
+				row[px] = r.rgb;
+		}
+	}
+}
+
+/* Convert the frame to the caller's format - grayscale uses the BT.601 weights */
+static void packFrame (const unsigned int *frame, int n, unsigned char *out, int channels)
+{
+	for (int i = 0; i < n; i++){
+		unsigned int p = frame[i];
+		unsigned int r = p & 0xff, g = (p >> 8) & 0xff, b = (p >> 16) & 0xff;
+		if(channels == 1)
+			out[i] = (77 * r + 150 * g + 29 * b) >> 8;
+		else {
+			out[3 * i] = r;
+			out[3 * i + 1] = g;
+			out[3 * i + 2] = b;
+		}
+	}
+}
+
+void rasterGames (GameInstance *games, int n, unsigned char *pixels, int width, int height, int channels)
+{
+	// One rectangle list and one frame of scratch serve the whole batch
+	vector<RasterRect> rects;
+	vector<unsigned int> frame((size_t) width * height);
+	size_t framebytes = (size_t) width * height * channels;
+	for (int g = 0; g < n; g++){
+		collectRects(games[g], rects);
+		fill(frame.begin(), frame.end(), BACKGROUND);
+		for (size_t i = 0; i < rects.size(); i++)
+			fillRect(frame.data(), width, height, rects[i]);
+		packFrame(frame.data(), width * height, pixels + g * framebytes, channels);
+	}
+}
+
+void rasterGame (GameInstance &game, unsigned char *pixels, int width, int height, int channels)
+{
+	rasterGames(&game, 1, pixels, width, height, channels);
+}
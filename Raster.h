@@ -0,0 +1,14 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "Game.h"
+
+/* Software renderer of the playfield for pixel observations - draws what draw() shows, without a GL context, */
+/* scaled to any size. Frames are channels bytes per pixel: 1 for grayscale, 3 for RGB, rows top to bottom. */
+
+/* Draw one game into pixels, width * height * channels bytes */
+void rasterGame (GameInstance &game, unsigned char *pixels, int width, int height, int channels);
+/* Draw n games into consecutive frames of pixels, game i's at pixels + i * width * height * channels */
+void rasterGames (GameInstance *games, int n, unsigned char *pixels, int width, int height, int channels);
+
+#endif
@@ -0,0 +1,115 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Game.h"
+#include "Replay.h"
+
+using namespace std;
+
+/* File layout: the magic "LGRP", a version byte and the seed, then one 10 byte record per event - tick, type, */
+/* arg, value - ending with an EV_END record whose tick is the session length. Numbers are in host byte order. */
+static const char REPLAY_MAGIC[4] = {'L', 'G', 'R', 'P'};
+static const unsigned char REPLAY_VERSION = 2;	// 2 - bricks come from the game's own generator, not rand()
+
+int startRecording (GameInstance &game, const char *path, unsigned int seed)
+{
+	game.recording = fopen(path, "wb");
+	if (!game.recording){
+		fprintf(stderr, "replay: cannot write %s\n", path);
+		return 0;
+	}
+	fwrite(REPLAY_MAGIC, 1, 4, game.recording);
+	fwrite(&REPLAY_VERSION, 1, 1, game.recording);
+	fwrite(&seed, 4, 1, game.recording);
+	return 1;
+}
+
+static void writeEvent (FILE *out, const ReplayEvent &e)
+{
+	fwrite(&e.tick, 4, 1, out);
+	fwrite(&e.type, 1, 1, out);
+	fwrite(&e.arg, 1, 1, out);
+	fwrite(&e.value, 4, 1, out);
+}
+
+void recordEvent (GameInstance &game, int type, int arg, float value)
+{
+	if (!game.recording)
+		return;
+	ReplayEvent e = {(unsigned int) game.simticks, (unsigned char) type, (unsigned char) arg, value};
+	writeEvent(game.recording, e);
+}
+
+void stopRecording (GameInstance &game)
+{
+	if (!game.recording)
+		return;
+	recordEvent(game, EV_END, 0, 0);
+	fclose(game.recording);
+	game.recording = NULL;
+}
+
+int loadReplay (const char *path, Replay &replay)
+{
+	FILE *in = fopen(path, "rb");
+	if (!in){
+		fprintf(stderr, "replay: cannot open %s\n", path);
+		return 0;
+	}
+	char magic[4];
+	unsigned char version;
+	if (fread(magic, 1, 4, in) != 4 || memcmp(magic, REPLAY_MAGIC, 4) != 0
+		|| fread(&version, 1, 1, in) != 1 || fread(&replay.seed, 4, 1, in) != 1){
+		fprintf(stderr, "replay: %s is not a recording\n", path);
+		fclose(in);
+		return 0;
+	}
+	if (version != REPLAY_VERSION){
+		fprintf(stderr, "replay: %s was recorded by a different version of the game\n", path);
+		fclose(in);
+		return 0;
+	}
+	replay.events.clear();
+	replay.length = -1;
+	ReplayEvent e;
+	while (fread(&e.tick, 4, 1, in) == 1 && fread(&e.type, 1, 1, in) == 1
+		&& fread(&e.arg, 1, 1, in) == 1 && fread(&e.value, 4, 1, in) == 1){
+		if (e.type == EV_END){
+			replay.length = e.tick;
+			break;
+		}
+		replay.events.push_back(e);
+	}
+	fclose(in);
+	// A session that crashed before closing its recording still replays up to its last input
+	if (replay.length < 0)
+		replay.length = replay.events.empty() ? 0 : replay.events.back().tick + 1;
+	return 1;
+}
+
+void playReplayEvents (GameInstance &game, const Replay &replay, size_t &next, long tick)
+{
+	// Live input stays locked out apart from the events being replayed
+	game.inputlocked = 0;
+	for (; next < replay.events.size() && replay.events[next].tick <= tick; next++){
+		const ReplayEvent &e = replay.events[next];
+		switch (e.type) {
+			case EV_ACTION:
+			applyAction(game, e.arg);
+			break;
+			case EV_BUCKET_X:
+			setBucketX(game, e.arg, e.value);
+			break;
+			case EV_GUN_Y:
+			setGunY(game, e.value);
+			break;
+			case EV_AIM:
+			aimGun(game, e.value);
+			break;
+			default:
+			break;
+		}
+	}
+	game.inputlocked = 1;
+}
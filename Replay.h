@@ -0,0 +1,40 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <vector>
+
+#include "Game.h"
+
+/* Recording of a session's seed and inputs, stamped with the simulation tick they arrived before, so replaying */
+/* them against the same seed reproduces the session tick for tick */
+
+/* Every way input changes the game - discrete actions, plus the mouse setting a position or angle outright */
+enum replayEventType { EV_ACTION, EV_BUCKET_X, EV_GUN_Y, EV_AIM, EV_END };
+
+struct ReplayEvent {
+	unsigned int tick;
+	unsigned char type;
+	unsigned char arg;	// the action for EV_ACTION, the bucket for EV_BUCKET_X
+	float value;		// the position or angle set
+};
+typedef struct ReplayEvent ReplayEvent;
+
+struct Replay {
+	unsigned int seed;
+	long length;	// ticks in the recorded session
+	std::vector<ReplayEvent> events;
+};
+typedef struct Replay Replay;
+
+/* Start writing a recording of game to path - game must already have been started with initGame(game, seed) */
+int startRecording (GameInstance &game, const char *path, unsigned int seed);
+/* Log one input at the current tick, if recording */
+void recordEvent (GameInstance &game, int type, int arg, float value);
+/* Mark the end of the session and close the file */
+void stopRecording (GameInstance &game);
+
+int loadReplay (const char *path, Replay &replay);
+/* Apply every event stamped with tick, starting from events[next] - next is advanced past them */
+void playReplayEvents (GameInstance &game, const Replay &replay, size_t &next, long tick);
+
+#endif
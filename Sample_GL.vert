@@ -3,6 +3,10 @@
 // input data : sent from main program
 layout (location = 0) in vec3 vertexPosition;
 layout (location = 1) in vec3 vertexColor;
+// placement of the unit square : centre (x, y) and size (width, height), then cos and sin of the rotation
+// per instance when drawing a batch, constant (0, 0, width, height) and (1, 0) otherwise
+layout (location = 2) in vec4 instanceRect;
+layout (location = 3) in vec2 instanceRotation;
 
 uniform mat4 MVP;
 
@@ -11,7 +15,10 @@ out vec3 fragColor;
 
 void main ()
 {
-    vec4 v = vec4(vertexPosition, 1); // Transform an homogeneous 4D vector
+    vec2 scaled = vertexPosition.xy * instanceRect.zw;
+    vec2 rotated = vec2(scaled.x * instanceRotation.x - scaled.y * instanceRotation.y,
+                        scaled.x * instanceRotation.y + scaled.y * instanceRotation.x);
+    vec4 v = vec4(rotated + instanceRect.xy, vertexPosition.z, 1); // Transform an homogeneous 4D vector
 
     // The color of each vertex will be interpolated
     // to produce the color of each fragment
@@ -2,10 +2,12 @@
 #include <cmath>
 #include <fstream>
 #include <vector>
-#include <map>
 #include <string>
 #include <time.h>
 #include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <chrono>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -15,6 +17,15 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "Game.h"
+#include "Digits.h"
+#include "Profiler.h"
+#include "Replay.h"
+#include "Capture.h"
+#ifdef OFFSCREEN
+#include "Offscreen.h"
+#endif
+
 using namespace std;
 
 struct VAO {
@@ -37,50 +48,18 @@ struct GLMatrices {
 
 GLuint programID;
 
-struct color{
-	float r, g, b;
-};
-typedef struct color color;
-bool operator==(const color& lhs, const color& rhs)
-{
-    return (lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b);
-}
-struct Object2D {
-	string name;
-	float x, y;
-	float height, width;
-	float angle;
-	color objcolor;
-	VAO *objectvao;
-	int active;
-};
+/* The one game this window shows and plays */
+GameInstance game;
+
+ObjectPool<Object2D> scoreparts;
+ObjectPool<Object2D> highlights;
+
+/* Objects that are looked up individually rather than iterated over */
+Handle redBucketLight, blueBucketLight;
 
-typedef struct Object2D Object2D;
-
-map <string, Object2D> bricks;
-map <string, Object2D> gunparts;
-map <string, Object2D> beam;
-map <string, Object2D> mirrors;
-map <string, Object2D> buckets;
-map <string, Object2D> scoreparts;
-map <string, Object2D> display;
-map <string, Object2D> lives;
-map <string, Object2D> highlights;
-
-color red = {1, 0, 0};
-color blue = {0, 1, 1};
-color black = {0, 0, 0};
-color grey = {168.0/255.0, 168.0/255.0, 168.0/255.0};
-color green = {0.5, 0, 1};
-color yellow = {1, 1, 0};
-int brickspeed;
-int beamind;
-int totalscore;
-double last_beam_time;
-int life;
-int gameover;
 float zoomamount;
 float dx, dy;
+int showcounters = 0;
 int leftclicked = 0;
 int rightclicked = 0;
 int clickedobj = -1;
@@ -247,9 +226,14 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 		glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
 
 		// Enable Vertex Attribute 1 - Color
-		glEnableVertexAttribArray(1);
-		// Bind the VBO to use
-		glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+		// VAOs without a color buffer take their color from the current glVertexAttrib value
+		if (vao->ColorBuffer) {
+			glEnableVertexAttribArray(1);
+			// Bind the VBO to use
+			glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+		}
+		else
+			glDisableVertexAttribArray(1);
 
 		// Draw the geometry !
 		glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
@@ -263,135 +247,33 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 
 /* Executed when a regular key is pressed/released/held-down */
 /* Prefered for Keyboard events */
+/* Unit square shared by every rectangle - size and color are supplied per draw */
 VAO *rectangle;
-void createRectangle (string name, color objcolor, float angle, float x, float y, float height, float width, string objclass)
+void createUnitRectangle ()
 {
-	//cout << objcolor.r << objcolor.g << objcolor.b;
 	// GL3 accepts only Triangles. Quads are not supported
 	GLfloat vertex_buffer_data [] = {
-		-width/2, height/2, 0, // vertex 1
-		-width/2, -height/2, 0, // vertex 2
-		width/2, height/2, 0, // vertex 3
-
-		width/2, height/2, 0, // vertex 3
-		width/2, -height/2, 0, // vertex 4
-		-width/2, -height/2, 0,  // vertex 1
-	};
-
-	GLfloat color_buffer_data [] = {
-		objcolor.r, objcolor.g, objcolor.b, // color 1
-		objcolor.r, objcolor.g, objcolor.b, // color 2
-		objcolor.r, objcolor.g, objcolor.b, // color 3
+		-0.5, 0.5, 0, // vertex 1
+		-0.5, -0.5, 0, // vertex 2
+		0.5, 0.5, 0, // vertex 3
 
-		objcolor.r, objcolor.g, objcolor.b, // color 3
-		objcolor.r, objcolor.g, objcolor.b, // color 4
-		objcolor.r, objcolor.g, objcolor.b, // color 1
+		0.5, 0.5, 0, // vertex 3
+		0.5, -0.5, 0, // vertex 4
+		-0.5, -0.5, 0,  // vertex 1
 	};
 
-	// create3DObject creates and returns a handle to a VAO that can be used later
-	rectangle = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-	Object2D obj = {};
-	obj.objectvao = rectangle;
-	obj.name = name;
-	obj.x = x;
-	obj.y = y;
-	obj.height = height;
-	obj.width = width;
-	obj.angle = angle;
-	obj.objcolor = objcolor;
-	obj.active = 1;
-	if (objclass == "buckets")
-	buckets[name] = obj;
-	else if (objclass == "bricks")
-	bricks[name] = obj;
-	else if (objclass == "gunparts")
-	gunparts[name] = obj;
-	else if (objclass == "scoreparts")
-	scoreparts[name] = obj;
-	else if (objclass == "mirrors")
-	mirrors[name] = obj;
-	else if (objclass == "display")
-	display[name] = obj;
-	else if (objclass == "lives")
-	lives[name] = obj;
-	else if (objclass == "highlights")
-	highlights[name] = obj;
-	else if (objclass == "beam"){
-		obj.active = 0;
-		beam[name] = obj;
-	}
-}
-void moveGunUporDown(int dir)
-{
-	for (map <string, Object2D> :: iterator it = gunparts.begin(); it != gunparts.end(); it++){
-		string name = it->first;
-		if(dir == 1 && gunparts[name].y <= 200)
-			gunparts[name].y += 10;
-		else if (dir == -1 && gunparts[name].y >= -150)
-			gunparts[name].y -= 10;
-		
-	}
-}
-void tiltGunUporDown(int dir)
-{
-	for (map <string, Object2D> :: iterator it = gunparts.begin(); it != gunparts.end(); it++){
-		string name = it->first;
-		if(dir == 1){
-			if((name == "gunArm" && gunparts[name].angle < 60.0) || (name == "gunBase2" && gunparts[name].angle < 105.0))
-				gunparts[name].angle += 10.0;	
-		}
-		if(dir == -1){
-			if((name == "gunArm" && gunparts[name].angle > -60.0) || (name == "gunBase2" && gunparts[name].angle > -15.0))
-				gunparts[name].angle -= 10.0;	
-		}
-		
-	}
-}
-void moveBucket(int color, int dir)
-{
-	if(color == 0 && dir == 1){
-		if(buckets["redBucket"].x <= 340.0)
-		buckets["redBucket"].x += 10;
-	}
-	if(color == 0 && dir == -1){
-		if(buckets["redBucket"].x >= -340.0)
-			buckets["redBucket"].x -= 10;
-	}
-	if(color == 1 && dir == 1){
-		if(buckets["blueBucket"].x <= 340.0)
-		buckets["blueBucket"].x += 10;
-	}
-	if(color == 1 && dir == -1){
-		if(buckets["blueBucket"].x >= -340.0)
-			buckets["blueBucket"].x -= 10;
-	}
-}
-void firegun()
-{
-	if(gunparts["gunArm"].active == 0)
-	{
-		last_beam_time = glfwGetTime();
-		char temp[10];
-		snprintf(temp, 10, "%d", beamind);
-		string str (temp);
-		str = "beam" + str;
-		createRectangle (str, red, 0.0, -375.0, 0, 1.0, 30.0, "beam");
-		beam[str].angle = gunparts["gunArm"].angle;
-		beam[str].x = gunparts["gunArm"].x - 375.0 + 70.0 * cos (beam[str].angle * M_PI/180.0);
-		beam[str].y = gunparts["gunArm"].y + 70.0 * sin (beam[str].angle * M_PI/180.0);
-		gunparts["gunArm"].active = 1;
-		beam[str].active = 1;
-		beamind ++;
-	}
-
-}
-int bottomCollision (Object2D a, Object2D b)
-{
-	if((a.y - (a.height)/2.0) < (b.y + (b.height)/2.0)){
-		if(((a.x + (a.width)/2.0) < (b.x + (b.width)/2.0)) && ((a.x - (a.width)/2.0) > (b.x - (b.width)/2.0)))
-			return 1;
-	}
-	return 0;
+	rectangle = new struct VAO;
+	rectangle->PrimitiveMode = GL_TRIANGLES;
+	rectangle->NumVertices = 6;
+	rectangle->FillMode = GL_FILL;
+	rectangle->ColorBuffer = 0;
+
+	glGenVertexArrays(1, &(rectangle->VertexArrayID));
+	glGenBuffers (1, &(rectangle->VertexBuffer));
+	glBindVertexArray (rectangle->VertexArrayID);
+	glBindBuffer (GL_ARRAY_BUFFER, rectangle->VertexBuffer);
+	glBufferData (GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
 }
 void zoom(int size)
 {
@@ -437,38 +319,37 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	 // Function is called first on GLFW_PRESS.
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, 1);
+	// Game input goes through applyAction, so it can be recorded
 	if ((glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS) && glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		moveBucket(0, 1);
+		applyAction(game, ACT_RED_RIGHT);
 	if ((glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS) && glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		moveBucket(0, -1);
+		applyAction(game, ACT_RED_LEFT);
 	if ((glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_ALT) == GLFW_PRESS) && glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-		moveBucket(1, 1);
+		applyAction(game, ACT_BLUE_RIGHT);
 	if ((glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS || glfwGetKey(window, GLFW_KEY_RIGHT_ALT) == GLFW_PRESS) && glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-		moveBucket(1, -1);
+		applyAction(game, ACT_BLUE_LEFT);
 	if (action == GLFW_RELEASE) {
 		switch (key) {
 			case GLFW_KEY_A:
-			tiltGunUporDown(1);
+			applyAction(game, ACT_TILT_UP);
 			break;
 			case GLFW_KEY_D:
-			tiltGunUporDown(-1);
+			applyAction(game, ACT_TILT_DOWN);
 			break;
 			case GLFW_KEY_S:
-			moveGunUporDown(1);
+			applyAction(game, ACT_GUN_UP);
 			break;
 			case GLFW_KEY_F:
-			moveGunUporDown(-1);
+			applyAction(game, ACT_GUN_DOWN);
 			break;
 			case GLFW_KEY_SPACE:
-			firegun();
+			applyAction(game, ACT_FIRE);
 			break;
 			case GLFW_KEY_N:
-			if(brickspeed < 7.0)
-				brickspeed ++;
+			applyAction(game, ACT_FASTER);
 			break;
 			case GLFW_KEY_M:
-			if(brickspeed > 1.0)
-				brickspeed --;
+			applyAction(game, ACT_SLOWER);
 			break;
 			case GLFW_KEY_UP:
 			zoom(1);
@@ -488,17 +369,26 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 			case GLFW_KEY_L:
 			pan(-2);
 			break;
+			case GLFW_KEY_C:
+			showcounters = !showcounters;
+			break;
+#ifdef PROFILE
+			case GLFW_KEY_T:
+			if (traceDump("trace.json"))
+				cout << "trace written to trace.json" << endl;
+			break;
+#endif
 			/*case GLFW_KEY_H:
-			moveBucket(0, 1);
+			moveBucket(game, 0, 1);
 			break;
 			case GLFW_KEY_J:
-			moveBucket(0, -1);
+			moveBucket(game, 0, -1);
 			break;
 			case GLFW_KEY_K:
-			moveBucket(1, 1);
+			moveBucket(game, 1, 1);
 			break;
 			case GLFW_KEY_L:
-			moveBucket(1, -1);
+			moveBucket(game, 1, -1);
 			break;*/
 			default:
 			break;
@@ -533,29 +423,28 @@ void mouseClicked(GLFWwindow* window)
 	glfwGetCursorPos(window, &curmousex, &curmousey);
 	curmousex -= 400.0;
 	curmousey = 300.0 - curmousey ;
-	if((curmousex < buckets["redBucket"].x + (buckets["redBucket"].width)/2.0)
-		&& (curmousex > buckets["redBucket"].x - (buckets["redBucket"].width)/2.0)
-		&& (curmousey < buckets["redBucket"].y + (buckets["redBucket"].height)/2.0)
-		&& (curmousey > buckets["redBucket"].y - (buckets["redBucket"].height)/2.0))
+	if((curmousex < game.buckets[game.redBucket].x + (game.buckets[game.redBucket].width)/2.0)
+		&& (curmousex > game.buckets[game.redBucket].x - (game.buckets[game.redBucket].width)/2.0)
+		&& (curmousey < game.buckets[game.redBucket].y + (game.buckets[game.redBucket].height)/2.0)
+		&& (curmousey > game.buckets[game.redBucket].y - (game.buckets[game.redBucket].height)/2.0))
 		clickedobj = 0;
-	else if((curmousex < buckets["blueBucket"].x + (buckets["blueBucket"].width)/2.0)
-		&& (curmousex > buckets["blueBucket"].x - (buckets["blueBucket"].width)/2.0)
-		&& (curmousey < buckets["blueBucket"].y + (buckets["blueBucket"].height)/2.0)
-		&& (curmousey > buckets["blueBucket"].y - (buckets["blueBucket"].height)/2.0))
+	else if((curmousex < game.buckets[game.blueBucket].x + (game.buckets[game.blueBucket].width)/2.0)
+		&& (curmousex > game.buckets[game.blueBucket].x - (game.buckets[game.blueBucket].width)/2.0)
+		&& (curmousey < game.buckets[game.blueBucket].y + (game.buckets[game.blueBucket].height)/2.0)
+		&& (curmousey > game.buckets[game.blueBucket].y - (game.buckets[game.blueBucket].height)/2.0))
 		clickedobj = 1;
-	else if((curmousex < -375.0 + gunparts["gunBase1"].x + (gunparts["gunBase1"].width))
-			&& (curmousex > -375.0 + gunparts["gunBase1"].x - (gunparts["gunBase1"].width)/2.0)
-			&& (curmousey < gunparts["gunBase1"].y + (gunparts["gunBase1"].height))
-			&& (curmousey > gunparts["gunBase1"].y - (gunparts["gunBase1"].height))){
+	else if((curmousex < -375.0 + game.gunparts[game.gunBase1].x + (game.gunparts[game.gunBase1].width))
+			&& (curmousex > -375.0 + game.gunparts[game.gunBase1].x - (game.gunparts[game.gunBase1].width)/2.0)
+			&& (curmousey < game.gunparts[game.gunBase1].y + (game.gunparts[game.gunBase1].height))
+			&& (curmousey > game.gunparts[game.gunBase1].y - (game.gunparts[game.gunBase1].height))){
 				clickedobj = 2;
 	}
 	else {
-		float m = (curmousey - gunparts["gunArm"].y)/(curmousex - gunparts["gunArm"].x + 375.0);
+		float m = (curmousey - game.gunparts[game.gunArm].y)/(curmousex - game.gunparts[game.gunArm].x + 375.0);
 		float angle = atan (m);
 		angle = angle * 180.0/M_PI;
 		if(angle > -60.0 && angle < 60.0){
-			gunparts["gunArm"].angle = angle;
-			gunparts["gunBase2"].angle = angle + 45.0;
+			aimGun(game, angle);
 			clickedobj = 3;
 		}
 	}
@@ -572,7 +461,7 @@ void mousescroll(GLFWwindow* window, double dx, double dy)
 void mouseReleased(GLFWwindow* window)
 {
 	if(clickedobj == 3)
-		firegun();
+		applyAction(game, ACT_FIRE);
 	leftclicked = 0;
 	clickedobj = -1;
 }
@@ -611,8 +500,9 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 {
 	int fbwidth=width, fbheight=height;
 	/* With Retina display on Mac OS X, GLFW's FramebufferSize
-	 is different from WindowSize */
-	glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+	 is different from WindowSize - offscreen there is no window, and the framebuffer is the size asked for */
+	if (window)
+		glfwGetFramebufferSize(window, &fbwidth, &fbheight);
 
 	GLfloat fov = 90.0f;
 
@@ -634,133 +524,301 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 /* Edit this function according to your assignment */
 glm::mat4 VP;
 glm::mat4 MVP;
+/* Draw an object with the current model matrix, scaling the shared unit square to its size */
+void drawRectangle (const Object2D &obj)
+{
+	MVP = VP * Matrices.model;
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+	glVertexAttrib3f(1, obj.objcolor.r, obj.objcolor.g, obj.objcolor.b);
+	glVertexAttrib4f(2, 0, 0, obj.width, obj.height);
+	glVertexAttrib2f(3, 1, 0);
+	draw3DObject(rectangle);
+}
+
+/* Per-instance attributes of the shared unit square, laid out to match Sample_GL.vert */
+struct RectInstance {
+	GLfloat r, g, b;
+	GLfloat x, y, width, height;
+	GLfloat cosangle, sinangle;
+};
+typedef struct RectInstance RectInstance;
+
+/* Instances of one class of objects, collected during the frame and drawn with a single call */
+struct InstanceBatch {
+	GLuint VertexArrayID;
+	GLuint InstanceBuffer;
+	int capacity;
+	vector<RectInstance> instances;
+};
+typedef struct InstanceBatch InstanceBatch;
+
+InstanceBatch brickbatch;
+InstanceBatch beambatch;
+InstanceBatch mirrorbatch;
+
+void createInstanceBatch (InstanceBatch &batch)
+{
+	batch.capacity = 0;
+	glGenVertexArrays(1, &(batch.VertexArrayID));
+	glGenBuffers (1, &(batch.InstanceBuffer));
+	glBindVertexArray (batch.VertexArrayID);
+
+	// Attribute 0 - vertices of the shared unit square
+	glBindBuffer (GL_ARRAY_BUFFER, rectangle->VertexBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+	// Attributes 1 to 3 - color, centre and size, rotation - advance once per instance
+	glBindBuffer (GL_ARRAY_BUFFER, batch.InstanceBuffer);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(RectInstance), (void*)offsetof(RectInstance, r));
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(RectInstance), (void*)offsetof(RectInstance, x));
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(RectInstance), (void*)offsetof(RectInstance, cosangle));
+	glVertexAttribDivisor(3, 1);
+}
+
+void addInstance (InstanceBatch &batch, const Object2D &obj, float alpha)
+{
+	RectInstance inst;
+	inst.r = obj.objcolor.r;
+	inst.g = obj.objcolor.g;
+	inst.b = obj.objcolor.b;
+	inst.x = obj.prevx + (obj.x - obj.prevx) * alpha;
+	inst.y = obj.prevy + (obj.y - obj.prevy) * alpha;
+	inst.width = obj.width;
+	inst.height = obj.height;
+	inst.cosangle = obj.dirx;
+	inst.sinangle = obj.diry;
+	batch.instances.push_back(inst);
+}
+
+/* Bricks are stored by field rather than as Object2D, and never rotate */
+void addBrickInstance (InstanceBatch &batch, int i, float alpha)
+{
+	RectInstance inst;
+	color c = brickColors[game.bricks.kind[i]];
+	inst.r = c.r;
+	inst.g = c.g;
+	inst.b = c.b;
+	inst.x = game.bricks.x[i];
+	inst.y = game.bricks.prevy[i] + (game.bricks.y[i] - game.bricks.prevy[i]) * alpha;
+	inst.width = game.bricks.width[i];
+	inst.height = game.bricks.height[i];
+	inst.cosangle = 1.0;
+	inst.sinangle = 0.0;
+	batch.instances.push_back(inst);
+}
+
+/* Copy the batch's instances into its buffer, growing it when they no longer fit */
+void uploadInstanceBatch (InstanceBatch &batch)
+{
+	int count = batch.instances.size();
+	glBindBuffer (GL_ARRAY_BUFFER, batch.InstanceBuffer);
+	if (count > batch.capacity)
+		batch.capacity = max(count, 2 * batch.capacity);
+	// Orphan the old storage so the upload does not wait on a draw still using it
+	glBufferData (GL_ARRAY_BUFFER, batch.capacity * sizeof(RectInstance), NULL, GL_STREAM_DRAW);
+	if (count > 0)
+		glBufferSubData (GL_ARRAY_BUFFER, 0, count * sizeof(RectInstance), &batch.instances[0]);
+}
+
+/* Draw the first count instances last uploaded to the batch, with the view's matrix */
+void drawInstances (InstanceBatch &batch, int count)
+{
+	MVP = VP;
+	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+	glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+	glBindVertexArray (batch.VertexArrayID);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, rectangle->NumVertices, count);
+}
+
+/* Upload the frame's instances and draw them all at once, then empty the batch */
+void drawInstanceBatch (InstanceBatch &batch)
+{
+	int count = batch.instances.size();
+	if (count == 0)
+		return;
+	uploadInstanceBatch(batch);
+	drawInstances(batch, count);
+	batch.instances.clear();
+}
 float camera_rotation_angle = 90.0;
-void drawDig(int dig, int place)
+
+void addBatchRect (InstanceBatch &batch, float x, float y, float width, float height, float cosangle, float sinangle, color c)
 {
-	float x, y;
-	if(place == 0){
-		if(dig == -1 || dig == -2 || dig == -3){
-			x = 30.0;
-			y = 0.0;
-		}
-		else {
-			x = 370.0;
-			y = 250.0;
-		}
-	}
-	else if(place == 1){
-		if(dig == -1 || dig == -2 || dig == -3){
-			x = 0.0;
-			y = 0.0;
-		}
-		else {
-			x = 340.0;
-			y = 250.0;
-		}
-	}
-	else if(place == 2){
-		if(dig == -1 || dig == -2 || dig == -3){
-			x = -30.0;
-			y = 0.0;
-		}
+	RectInstance inst = {c.r, c.g, c.b, x, y, width, height, cosangle, sinangle};
+	batch.instances.push_back(inst);
+}
+
+/* Add the segments of text to the batch - see layoutText for how it is placed */
+void addText (InstanceBatch &batch, const char *text, float x, float y, float scale, int align, color c)
+{
+	layoutText(text, x, y, scale, align, [&] (float sx, float sy, float width, float height) {
+		addBatchRect(batch, sx, sy, width, height, 1.0, 0.0, c);
+	});
+}
+
+/* The score, lives and game over banner - kept in their own batch, which is only rebuilt and uploaded */
+/* when what it shows changes, so most frames the whole HUD is one draw call and no upload */
+InstanceBatch hudbatch;
+int hudscore = -1, hudlife = -1, hudgameover = -1;
+
+void drawHud ()
+{
+	if(game.totalscore != hudscore || game.life != hudlife || game.gameover != hudgameover){
+		hudscore = game.totalscore;
+		hudlife = game.life;
+		hudgameover = game.gameover;
+		hudbatch.instances.clear();
+		if(game.gameover)
+			addText(hudbatch, GAMEOVER_TEXT, 0.0, 0.0, 1.0, ALIGN_CENTRE, black);
 		else {
-			x = 310.0;
-			y = 250.0;
+			char score[16];
+			snprintf(score, sizeof(score), "%d", game.totalscore);
+			addText(hudbatch, score, SCORE_X, SCORE_Y, 1.0, ALIGN_RIGHT, black);
+			// The first marker stays up through the last life
+			float diag = sqrt(0.5f);
+			for (int l = 0; l < 3 && (l == 0 || l < game.life); l++)
+				addBatchRect(hudbatch, LIFE_X[l], LIFE_Y, LIFE_SIZE, LIFE_SIZE, diag, diag, green);
 		}
+		uploadInstanceBatch(hudbatch);
 	}
-	if(dig == 0 || dig == 2 || dig == 3 || dig == 5 || dig == 6 || dig == 7 || dig == 8 || dig == 9 || dig == -3){
-		string name;
-		if(place == 0) name = "top";
-		else if(place == 1) name = "top1";
-		else if(place == 2) name = "top2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+	drawInstances(hudbatch, hudbatch.instances.size());
+}
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
-	}
-	if(dig == 0 || dig == 1 || dig == 2 || dig == 3 || dig == 4 || dig == 7 || dig == 8 || dig == 9 || dig == -1){
-		string name;
-		if(place == 0) name = "topright";
-		else if(place == 1) name = "topright1";
-		else if(place == 2) name = "topright2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+/* Frame rate and simulated ticks in the top left corner, toggled with c - drawn like the HUD, but fixed to */
+/* the screen whatever the zoom and pan, and rebuilt only when the text changes */
+const double COUNTER_INTERVAL = 0.5;
+InstanceBatch counterbatch;
+string countertext;
+chrono::steady_clock::time_point counterstart = chrono::steady_clock::now();
+long counterframes = 0;
+double counterfps = 0;
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
+void drawCounters ()
+{
+	// Frames per second over the last interval, so the figure is steady enough to read
+	counterframes ++;
+	double elapsed = chrono::duration<double>(chrono::steady_clock::now() - counterstart).count();
+	if(elapsed >= COUNTER_INTERVAL){
+		counterfps = counterframes / elapsed;
+		counterframes = 0;
+		counterstart = chrono::steady_clock::now();
 	}
-	if(dig == 0 || dig == 4 || dig == 5 || dig == 6 || dig == 8 || dig == 9 || dig == -3){
-		string name;
-		if(place == 0) name = "topleft";
-		else if(place == 1) name = "topleft1";
-		else if(place == 2) name = "topleft2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+	if(!showcounters)
+		return;
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
+	char fps[32], ticks[32];
+	snprintf(fps, sizeof(fps), "%.0f FPS", counterfps);
+	snprintf(ticks, sizeof(ticks), "%ld t", game.simticks);
+	string text = string(fps) + " " + ticks;
+	if(text != countertext){
+		countertext = text;
+		counterbatch.instances.clear();
+		addText(counterbatch, fps, -390.0, 285.0, 0.5, ALIGN_LEFT, grey);
+		addText(counterbatch, ticks, -390.0, 260.0, 0.5, ALIGN_LEFT, grey);
+		uploadInstanceBatch(counterbatch);
 	}
-	if(dig == 2 || dig == 3 || dig == 4 || dig == 5 || dig == 6 || dig == 8 || dig == 9 || dig == -1 || dig == -2 || dig == -3){
-		string name;
-		if(place == 0) name = "middle";
-		else if(place == 1) name = "middle1";
-		else if(place == 2) name = "middle2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+	glm::mat4 sceneVP = VP;
+	VP = glm::ortho(-400.0f, 400.0f, -300.0f, 300.0f, 0.1f, 500.0f) * Matrices.view;
+	drawInstances(counterbatch, counterbatch.instances.size());
+	VP = sceneVP;
+}
+#ifdef PROFILE
+/* GPU time of each frame's draw calls, read back GPU_QUERY_LAG frames later so waiting for the result never stalls the pipeline */
+const int GPU_QUERY_LAG = 4;
+GLuint gpuqueries[GPU_QUERY_LAG];
+int gpuqueryframe[GPU_QUERY_LAG];
+int gputimers;
+InstanceBatch profilebatch;
+
+void initProfiler ()
+{
+	createInstanceBatch(profilebatch);
+	gputimers = GLAD_GL_VERSION_3_3 || GLAD_GL_ARB_timer_query;
+	if (gputimers)
+		glGenQueries(GPU_QUERY_LAG, gpuqueries);
+	for (int q = 0; q < GPU_QUERY_LAG; q++)
+		gpuqueryframe[q] = -1;
+	profileEndFrame();
+}
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
+void beginGpuTimer ()
+{
+	if (!gputimers)
+		return;
+	Profiler &p = profiler();
+	int q = p.frameno % GPU_QUERY_LAG;
+	// Collect what this query measured GPU_QUERY_LAG frames ago before reusing it - a result still not ready is dropped
+	if (gpuqueryframe[q] >= 0){
+		GLint ready = 0;
+		glGetQueryObjectiv(gpuqueries[q], GL_QUERY_RESULT_AVAILABLE, &ready);
+		if (ready){
+			GLuint64 ns;
+			glGetQueryObjectui64v(gpuqueries[q], GL_QUERY_RESULT, &ns);
+			p.frames[gpuqueryframe[q]].gpu = ns;
+		}
 	}
-	if(dig == 0 || dig == 1 || dig == 3 || dig == 4 || dig == 5 || dig == 6 || dig == 7 || dig == 8 || dig == 9 || dig == -2 || dig == -1){
-		string name;
-		if(place == 0) name = "botright";
-		else if(place == 1) name = "botright1";
-		else if(place == 2) name = "botright2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+	glBeginQuery(GL_TIME_ELAPSED, gpuqueries[q]);
+	gpuqueryframe[q] = p.current;
+}
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
-	}
-	if(dig == 0 || dig == 2 || dig == 6 || dig == 8 || dig == -1 || dig == -2 || dig == -3){
-		string name;
-		if(place == 0) name = "botleft";
-		else if(place == 1) name = "botleft1";
-		else if(place == 2) name = "botleft2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+void endGpuTimer ()
+{
+	if (gputimers)
+		glEndQuery(GL_TIME_ELAPSED);
+}
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
-	}
-	if(dig == 0 || dig == 2 || dig == 3 || dig == 5 || dig == 6 || dig == 8 || dig == 9 || dig == -1 || dig == -3){
-		string name;
-		if(place == 0) name = "bottom";
-		else if(place == 1) name = "bottom1";
-		else if(place == 2) name = "bottom2";
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(x + display[name].x, y + display[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle);
+void addOverlayRect (float x, float y, float width, float height, color c)
+{
+	Object2D r = {};
+	r.x = r.prevx = x;
+	r.y = r.prevy = y;
+	r.width = width;
+	r.height = height;
+	r.objcolor = c;
+	setAngle(r, 0.0);
+	addInstance(profilebatch, r, 1.0);
+}
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(display[name].objectvao);
+/* Frame-time graph in the bottom left corner, oldest frame first: one bar per frame with the */
+/* CPU stages stacked in blue (update), red (draw), grey (swap) and yellow (events), a mark at the */
+/* GPU time, and a line at the 60 fps budget - 4 units to the millisecond */
+void drawProfileOverlay ()
+{
+	const float UNITS_PER_NS = 4e-6;
+	color stagecolors[NUM_STAGES] = {blue, red, grey, yellow};
+	Profiler &p = profiler();
+
+	// Fixed to the screen, whatever the zoom and pan
+	VP = glm::ortho(-400.0f, 400.0f, -300.0f, 300.0f, 0.1f, 500.0f) * Matrices.view;
+	for (int f = 1; f < PROFILE_FRAMES; f++){
+		FrameTimes &t = p.frames[(p.current + f) % PROFILE_FRAMES];
+		float x = -394.0 + 2.0 * f;
+		float y = -295.0;
+		for (int s = 0; s < NUM_STAGES; s++){
+			float h = t.cpu[s] * UNITS_PER_NS;
+			if (h > 0)
+				addOverlayRect(x, y + h/2.0, 2.0, h, stagecolors[s]);
+			y += h;
+		}
+		if (t.gpu > 0)
+			addOverlayRect(x, -295.0 + t.gpu * UNITS_PER_NS, 2.0, 1.0, green);
 	}
+	addOverlayRect(-395.0 + PROFILE_FRAMES, -295.0 + 1e9/60.0 * UNITS_PER_NS, 2.0 * PROFILE_FRAMES, 1.0, black);
+	drawInstanceBatch(profilebatch);
 }
-void draw (GLFWwindow* window)
+#endif
+
+/* Longest stretch of wall-clock time simulated in one frame, so a stall does not snowball into ever longer catch-ups */
+const double MAX_FRAME_TIME = 0.25;
+
+/* Render the scene, placing moving objects alpha of the way from their previous tick to the current one */
+void draw (GLFWwindow* window, float alpha)
 {
 	// clear the color and depth in the frame buffer
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -815,12 +873,14 @@ void draw (GLFWwindow* window)
 	//glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 	//glm::mat4 scaleRectangle = glm::scale(glm::vec3(2.0f, 2.0f ,2.0f));
 	//Draw bricks
-	if(gameover){
-		drawDig(-3, 2);
-		drawDig(-2, 1);
-		drawDig(-1, 0);
+	if(game.gameover){
+		TRACE_BEGIN("hud");
+		drawHud();
+		drawCounters();
+		TRACE_END("hud");
 		return;
 	}
+	TRACE_BEGIN("input");
 	if(rightclicked){
 		glfwGetCursorPos(window, &curmousex, &curmousey);
 		curmousex -= 400.0;
@@ -848,244 +908,76 @@ void draw (GLFWwindow* window)
 		curmousey = 300.0 - curmousey;
 		if(clickedobj == 0){
 			if(curmousex < 400.0 && curmousex > -400.0)
-				buckets["redBucket"].x = curmousex;
+				setBucketX(game, 0, curmousex);
 			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(buckets["redBucket"].x, buckets["redBucket"].y, 0));        // glTranslatef
+			glm::mat4 translateRectangle = glm::translate (glm::vec3(game.buckets[game.redBucket].x, game.buckets[game.redBucket].y, 0));        // glTranslatef
 			Matrices.model *= (translateRectangle /** rotateRectangle * scaleRectangle*/);
 
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(highlights["redBucketLight"].objectvao);
+			drawRectangle(highlights[redBucketLight]);
 		}
 		else if(clickedobj == 1){
 			if(curmousex < 400.0 && curmousex > -400.0)
-				buckets["blueBucket"].x = curmousex;
+				setBucketX(game, 1, curmousex);
 			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(buckets["blueBucket"].x, buckets["blueBucket"].y, 0));        // glTranslatef
+			glm::mat4 translateRectangle = glm::translate (glm::vec3(game.buckets[game.blueBucket].x, game.buckets[game.blueBucket].y, 0));        // glTranslatef
 			Matrices.model *= (translateRectangle /** rotateRectangle * scaleRectangle*/);
 
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(highlights["blueBucketLight"].objectvao);
+			drawRectangle(highlights[blueBucketLight]);
 		}
 		else if(clickedobj == 2){
-			if(curmousey <= 200.0 && curmousey >= -150.0){
-				for (map <string, Object2D> :: iterator it = gunparts.begin(); it != gunparts.end(); it++){
-				string name = it->first;
-				gunparts[name].y = curmousey;
-				}
-			}
+			setGunY(game, curmousey);
 		}
 	}
-	if (!bricks.empty()){
-		for (map <string, Object2D> :: iterator it = bricks.begin(); it != bricks.end(); it++){
-			string name = it->first;
-			if(bricks[name].active == 2) continue;
-			//Transformations
-			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(bricks[name].x, bricks[name].y, 0));        // glTranslatef
-			Matrices.model *= (translateRectangle /** rotateRectangle * scaleRectangle*/);
-
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(bricks[name].objectvao);
-			bricks[name].y -= brickspeed;
-			if(bricks[name].active == 1){
-				if(bricks[name].y < -240.0){
-					string brickcolor;
-					if(bricks[name].objcolor == blue) brickcolor = "blue";
-					else if(bricks[name].objcolor == red) brickcolor = "red";
-					else if(bricks[name].objcolor == black) brickcolor = "black";
-					
-					if(brickcolor == "red"){
-						if(bottomCollision(bricks[name], buckets["redBucket"]) == 1){
-							totalscore += 10;
-							bricks[name].active = 2;
-						}
-						else
-							bricks[name].active = 0;
-					}
-					if(brickcolor == "blue"){
-						if(bottomCollision(bricks[name], buckets["blueBucket"]) == 1){
-							totalscore += 10;
-							bricks[name].active = 2;
-						}
-						else
-							bricks[name].active = 0;
-					}
-					if(brickcolor == "black"){
-						if(bottomCollision(bricks[name], buckets["redBucket"]) == 1 
-							|| bottomCollision(bricks[name], buckets["blueBucket"]) == 1){
-							bricks[name].active = 2;
-							gameover = 1;
-						}
-						else
-							bricks[name].active = 0;
-					}
-				}
-				if(bricks[name].y < - 350.0)
-					bricks[name].active = 2;
-				else {
-					for (map <string, Object2D> :: iterator it1 = beam.begin(); it1 != beam.end(); it1++){
-						string beamname = it1->first;
-						if(beam[beamname].active == 0)
-							continue;
-						string brickcolor;
-						if(bricks[name].objcolor == blue) brickcolor = "blue";
-						else if(bricks[name].objcolor == red) brickcolor = "red";
-						else if(bricks[name].objcolor == black) brickcolor = "black";
-						if((bricks[name].x + (bricks[name].width)/2.0 > beam[beamname].x + 15.0 * cos (beam[beamname].angle * M_PI/180.0)/*(beam[beamname].width)/2.0*/) 
-							&& (bricks[name].x - (bricks[name].width)/2.0 < beam[beamname].x + 15.0 * cos (beam[beamname].angle * M_PI/180.0)/*(beam[beamname].width)/2.0*/)
-							&& (bricks[name].y + (bricks[name].height)/2.0 > beam[beamname].y + 15.0 * sin (beam[beamname].angle * M_PI/180.0)/*(beam[beamname].height)/2.0*/)
-							&& (bricks[name].y - (bricks[name].height)/2.0 < beam[beamname].y + 15.0 * sin (beam[beamname].angle * M_PI/180.0)/*(beam[beamname].height)/2.0*/)){
-							bricks[name].active = 2;
-							beam[beamname].active = 0;
-							if(brickcolor == "black")
-								totalscore += 10;
-							else {
-								life -= 1;
-								totalscore -= 5;
-								if(totalscore < 0)
-									totalscore = 0;
-								if(life == 0)
-									gameover = 1;
-							}
-						}	
-					}			
-				}
-			}
-		}
+	TRACE_END("input");
+	//Draw bricks
+	TRACE_BEGIN("bricks");
+	for (int i = 0; i < game.bricks.size(); i++){
+		if(game.bricks.active[i] == 2) continue;
+		addBrickInstance(brickbatch, i, alpha);
 	}
+	drawInstanceBatch(brickbatch);
+	TRACE_END("bricks");
 	//Draw Beam
-	if(!beam.empty()){
-		for (map <string, Object2D> :: iterator it1 = beam.begin(); it1 != beam.end(); it1++){
-			string beamname = it1->first;
-			if(beam[beamname].active == 0) continue;
-			Matrices.model = glm::mat4(1.0f);
-			glm::mat4 rotateRectangle = glm::rotate((float)(beam[beamname].angle * M_PI/180.0f), glm::vec3(0,0,1));
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(beam[beamname].x, beam[beamname].y, 0));        // glTranslatef
-			Matrices.model *= (translateRectangle * rotateRectangle /** scaleRectangle*/);
-
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(beam[beamname].objectvao);
-			beam[beamname].x += 10.0 * cos(beam[beamname].angle * M_PI/180.0f);
-			beam[beamname].y += 10.0 * sin(beam[beamname].angle * M_PI/180.0f);
-			if(beam[beamname].x > 400.0 || beam[beamname].x < -400.0 || beam[beamname].y > 300.0 || 
-				beam[beamname].y < -300.0){
-				beam[beamname].active = 0;
-				break;
-			}
-			for (map <string, Object2D> :: iterator it = mirrors.begin(); it != mirrors.end(); it++){
-				string name = it->first;
-				float m = tan (mirrors[name].angle * M_PI/180);
-				float perpd = fabs(m * (beam[beamname].x + 15.0 * cos(beam[beamname].angle * M_PI/180.0)) - (beam[beamname].y + 15.0 * sin (beam[beamname].angle * M_PI/180.0)) + mirrors[name].y - m * mirrors[name].x)/sqrt(pow(m, 2.0) + 1.0);
-				if(perpd < 10.0/sqrt(2.0)){
-					float d = sqrt(pow((beam[beamname].x + 15.0 * cos(beam[beamname].angle * M_PI/180.0)) - mirrors[name].x, 2) + pow((beam[beamname].y + 15.0 * sin (beam[beamname].angle * M_PI/180.0)) - mirrors[name].y, 2));
-					if(d < 10.0/sqrt(2.0) + 15.0){
-						float approachangle = fmod(beam[beamname].angle, 360);
-						if(approachangle < 0.0)
-							approachangle += 360.0;
-						if(mirrors[name].angle == 45.0){
-							if(approachangle > 45.0 && approachangle < 225.0){
-								beam[beamname].active = 0;
-								break;
-							}
-						}
-						else if(mirrors[name].angle == 135.0){
-							if(approachangle > 135.0 && approachangle < 315.0){
-								beam[beamname].active = 0;
-								break;
-							}
-						}
-						else if(mirrors[name].angle == 315.0){
-							if(approachangle > 315.0 || approachangle < 135.0){
-								beam[beamname].active = 0;
-								break;
-							}
-						}
-						beam[beamname].angle = 2.0 * mirrors[name].angle - beam[beamname].angle;
-						break;
-					}
-				}
-				
-			}
-		}
+	TRACE_BEGIN("beams");
+	for (ObjectPool<Beam> :: iterator it1 = game.beam.begin(); it1 != game.beam.end(); it1++){
+		if(it1->active == 0) continue;
+		addInstance(beambatch, *it1, alpha);
 	}
+	drawInstanceBatch(beambatch);
+	TRACE_END("beams");
 	//Draw mirrors
-	for (map <string, Object2D> :: iterator it = mirrors.begin(); it != mirrors.end(); it++){
-		string name = it->first;
-		//Transformations
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 rotateRectangle = glm::rotate((float)(mirrors[name].angle * M_PI/180.0f), glm::vec3(0,0,1));
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(mirrors[name].x, mirrors[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle * rotateRectangle /** scaleRectangle*/);
-
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(mirrors[name].objectvao);
-	}
+	TRACE_BEGIN("mirrors");
+	for (ObjectPool<Object2D> :: iterator it = game.mirrors.begin(); it != game.mirrors.end(); it++)
+		addInstance(mirrorbatch, *it, 1.0);
+	drawInstanceBatch(mirrorbatch);
+	TRACE_END("mirrors");
 	//Draw Buckets
-	for (map <string, Object2D> :: iterator it = buckets.begin(); it != buckets.end(); it++){
-		string name = it->first;
+	TRACE_BEGIN("buckets and gun");
+	for (ObjectPool<Object2D> :: iterator it = game.buckets.begin(); it != game.buckets.end(); it++){
+		Object2D &obj = *it;
 		//Transformations
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(buckets[name].x, buckets[name].y, 0));        // glTranslatef
+		glm::mat4 translateRectangle = glm::translate (glm::vec3(obj.x, obj.y, 0));        // glTranslatef
 		Matrices.model *= (translateRectangle /** rotateRectangle * scaleRectangle*/);
 
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(buckets[name].objectvao);
+		drawRectangle(obj);
 	}
 	//Draw Gun
-	for (map <string, Object2D> :: iterator it = gunparts.begin(); it != gunparts.end(); it++){
-		string name = it->first;
+	for (ObjectPool<Object2D> :: iterator it = game.gunparts.begin(); it != game.gunparts.end(); it++){
+		Object2D &obj = *it;
 		//Transformations
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 rotateRectangle = glm::rotate((float)(gunparts[name].angle * M_PI/180.0f), glm::vec3(0,0,1));
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(-375.0 + gunparts[name].x, gunparts[name].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle * rotateRectangle /** scaleRectangle*/);
-
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(gunparts[name].objectvao);
-	}
-	if(totalscore == 0) drawDig(0, 0);
-	else {
-		int score = totalscore;
-		int place = 0;
-		while(score){
-			int dig = score % 10;
-			drawDig(dig, place);
-			score /= 10;
-			place ++;
-		}
-	}
-	Matrices.model = glm::mat4(1.0f);
-	glm::mat4 rotateRectangle = glm::rotate((float)(45.0 * M_PI/180.0f), glm::vec3(0,0,1));
-	glm::mat4 translateRectangle = glm::translate (glm::vec3(lives["life1"].x, lives["life1"].y, 0));        // glTranslatef
-	Matrices.model *= (translateRectangle * rotateRectangle /** scaleRectangle*/);
-	MVP = VP * Matrices.model;
-	glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-	draw3DObject(lives["life1"].objectvao);
-	if(life >= 2){
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(lives["life2"].x, lives["life2"].y, 0));        // glTranslatef
+		glm::mat4 rotateRectangle = glm::rotate((float)(obj.angle * M_PI/180.0f), glm::vec3(0,0,1));
+		glm::mat4 translateRectangle = glm::translate (glm::vec3(-375.0 + obj.x, obj.y, 0));        // glTranslatef
 		Matrices.model *= (translateRectangle * rotateRectangle /** scaleRectangle*/);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(lives["life2"].objectvao);
-
-	}
-	if(life == 3){
-		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateRectangle = glm::translate (glm::vec3(lives["life3"].x, lives["life3"].y, 0));        // glTranslatef
-		Matrices.model *= (translateRectangle * rotateRectangle /** scaleRectangle*/);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(lives["life3"].objectvao);
 
+		drawRectangle(obj);
 	}
+	TRACE_END("buckets and gun");
+	TRACE_BEGIN("hud");
+	drawHud();
+	drawCounters();
+	TRACE_END("hud");
 	// Increment angles
 	//float increments = 1;
 
@@ -1148,54 +1040,17 @@ GLFWwindow* initGLFW (int width, int height)
 	{
 		/* Objects should be created before any other gl function and shaders */
 	// Create the models
+		createUnitRectangle();
+		createInstanceBatch(brickbatch);
+		createInstanceBatch(beambatch);
+		createInstanceBatch(mirrorbatch);
 	//createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
-		//Buckets
-		createRectangle ("redBucket", red, 0.0, 200.0, -275.0, 50.0, 100.0, "buckets");
-		createRectangle ("blueBucket", blue, 0.0, -200.0, -275.0, 50.0, 100.0, "buckets");
-		//Cannons
-		createRectangle ("gunBase1", black, 0.0, 0, 0, 75.0, 75.0, "gunparts");
-		createRectangle ("gunBase2", black, 45.0, 0, 0, 75.0, 75.0, "gunparts");
-		createRectangle ("gunArm", black, 0.0, 0, 0, 10.0, 150.0, "gunparts");
-		//Mirrors
-		createRectangle ("mirror1", grey, 135.0, 0, 135.0, 3.0, 50.0, "mirrors");
-		createRectangle ("mirror1back", black, 135.0, 2.0, 137.0, 2.0, 50.0, "mirrors");
-		createRectangle ("mirror2", grey, 45.0, 165.0, 70.0, 3.0, 50.0, "mirrors");
-		createRectangle ("mirror2back", black, 45.0, 167.0, 68.0, 2.0, 50.0, "mirrors");
-		createRectangle ("mirror3", grey, 45.0, 165.0, -135.0, 3.0, 50.0, "mirrors");
-		createRectangle ("mirror3back", black, 45.0, 167.0, -137.0, 2.0, 50.0, "mirrors");
-		createRectangle ("mirror4", grey, 315.0, -110.0, -25.0, 3.0, 50.0, "mirrors");
-		createRectangle ("mirror4back", black, 315.0, -112.0, -27.0, 2.0, 50.0, "mirrors");
-		//Display units
-		createRectangle ("topright", black, 0.0, 7.5, 7.5, 20.0, 5.0, "display");
-		createRectangle ("topleft", black, 0.0, -7.5, 7.5, 20.0, 5.0, "display");
-		createRectangle ("top", black, 0.0, 0, 15.0, 5.0, 20.0, "display");
-		createRectangle ("middle", black, 0.0, 0, 0, 5.0, 20.0, "display");
-		createRectangle ("botright", black, 0.0, 7.5, -7.5, 20.0, 5.0, "display");
-		createRectangle ("botleft", black, 0.0, -7.5, -7.5, 20.0, 5.0, "display");
-		createRectangle ("bottom", black, 0.0, 0, -15.0, 5.0, 20.0, "display");
-		//Display tens
-		createRectangle ("topright1", black, 0.0, 7.5, 7.5, 20.0, 5.0, "display");
-		createRectangle ("topleft1", black, 0.0, -7.5, 7.5, 20.0, 5.0, "display");
-		createRectangle ("top1", black, 0.0, 0, 15.0, 5.0, 20.0, "display");
-		createRectangle ("middle1", black, 0.0, 0, 0, 5.0, 20.0, "display");
-		createRectangle ("botright1", black, 0.0, 7.5, -7.5, 20.0, 5.0, "display");
-		createRectangle ("botleft1", black, 0.0, -7.5, -7.5, 20.0, 5.0, "display");
-		createRectangle ("bottom1", black, 0.0, 0, -15.0, 5.0, 20.0, "display");
-		//Display hundreds
-		createRectangle ("topright2", black, 0.0, 7.5, 7.5, 20.0, 5.0, "display");
-		createRectangle ("topleft2", black, 0.0, -7.5, 7.5, 20.0, 5.0, "display");
-		createRectangle ("top2", black, 0.0, 0, 15.0, 5.0, 20.0, "display");
-		createRectangle ("middle2", black, 0.0, 0, 0, 5.0, 20.0, "display");
-		createRectangle ("botright2", black, 0.0, 7.5, -7.5, 20.0, 5.0, "display");
-		createRectangle ("botleft2", black, 0.0, -7.5, -7.5, 20.0, 5.0, "display");
-		createRectangle ("bottom2", black, 0.0, 0, -15.0, 5.0, 20.0, "display");
-		//Lives
-		createRectangle ("life1", green, 45.0, 310.0, 200.0, 10.0, 10.0, "lives");
-		createRectangle ("life2", green, 45.0, 340.0, 200.0, 10.0, 10.0, "lives");
-		createRectangle ("life3", green, 45.0, 370.0, 200.0, 10.0, 10.0, "lives");
+		//Score, lives and counters
+		createInstanceBatch(hudbatch);
+		createInstanceBatch(counterbatch);
 		//Highlights
-		createRectangle ("redBucketLight", yellow, 0.0, 200.0, -275.0, 55.0, 105.0, "highlights");
-		createRectangle ("blueBucketLight", yellow, 0.0, -200.0, -275.0, 55.0, 105.0, "highlights");
+		redBucketLight = createRectangle (highlights, yellow, 0.0, 200.0, -275.0, 55.0, 105.0);
+		blueBucketLight = createRectangle (highlights, yellow, 0.0, -200.0, -275.0, 55.0, 105.0);
 
 
 	// Create and compile our GLSL program from the shaders
@@ -1217,55 +1072,247 @@ GLFWwindow* initGLFW (int width, int height)
 	cout << "VERSION: " << glGetString(GL_VERSION) << endl;
 	cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
 }
+/* Soak test - plays random input on simulated time and checks that object counts stay bounded */
+/* A leak in the object lifecycle shows up as one of these limits being exceeded */
+const int SOAK_MAX_BRICKS = 64;
+const int SOAK_MAX_BEAMS = 16;
+
+/* Run the simulation for the given number of hours; returns 0 on success and 1 on failure */
+int soak (double soakhours)
+{
+	int soakgames = 1;
+	while (game.simtime < soakhours * 3600.0){
+		switch (rand() % 8) {
+			case 0:
+			tiltGunUporDown(game, rand() % 2 ? 1 : -1);
+			break;
+			case 1:
+			moveGunUporDown(game, rand() % 2 ? 1 : -1);
+			break;
+			case 2:
+			moveBucket(game, rand() % 2, rand() % 2 ? 1 : -1);
+			break;
+			default:
+			firegun(game);
+			break;
+		}
+		update(game, TICK);
+		if (game.gameover){
+			resetGame(game);
+			soakgames ++;
+		}
+		if (game.bricks.size() > SOAK_MAX_BRICKS || game.beam.size() > SOAK_MAX_BEAMS){
+			fprintf(stderr, "soak: object count unbounded at %.0fs - bricks %d, beams %d\n",
+				game.simtime, game.bricks.size(), game.beam.size());
+			return 1;
+		}
+	}
+	printf("soak: %.1f hours, %d games - bricks %d, beams %d\n",
+		soakhours, soakgames, game.bricks.size(), game.beam.size());
+	return 0;
+}
+
 int main (int argc, char** argv)
 {
 	int width = 800;
 	int height = 600;
+	double soakhours = 0;
+	const char *recordpath = NULL;
+	const char *replaypath = NULL;
+	unsigned int seed = time(NULL);
+	long offscreenframes = 0;
+#ifdef OFFSCREEN
+	const char *dumpdir = NULL;
+	long dumpevery = 1;
+#endif
+	const char *capturepath = NULL;
+
+	for (int i = 1; i < argc; i++){
+		if (string(argv[i]) == "--soak"){
+			// The hours are optional, so the next argument is only taken as them if it is a number
+			soakhours = 1.0;
+			char *end;
+			if (i + 1 < argc){
+				double hours = strtod(argv[i + 1], &end);
+				if (end != argv[i + 1] && *end == '\0'){
+					soakhours = hours;
+					i ++;
+				}
+			}
+		}
+		else if (string(argv[i]) == "--record" && i + 1 < argc)
+			recordpath = argv[++i];
+		else if (string(argv[i]) == "--replay" && i + 1 < argc)
+			replaypath = argv[++i];
+		else if (string(argv[i]) == "--seed" && i + 1 < argc)
+			seed = strtoul(argv[++i], NULL, 10);
+		else if (string(argv[i]) == "--offscreen" && i + 1 < argc)
+			offscreenframes = atol(argv[++i]);
+#ifdef OFFSCREEN
+		else if (string(argv[i]) == "--dump" && i + 1 < argc)
+			dumpdir = argv[++i];
+		else if (string(argv[i]) == "--dump-every" && i + 1 < argc)
+			dumpevery = max(1L, atol(argv[++i]));
+#else
+		else if (string(argv[i]) == "--dump" || string(argv[i]) == "--dump-every"){
+			fprintf(stderr, "%s needs a build with -DOFFSCREEN (make -f Makefile.linux sample2D_offscreen)\n", argv[i]);
+			return 1;
+		}
+#endif
+		else if (string(argv[i]) == "--capture" && i + 1 < argc)
+			capturepath = argv[++i];
+		else if (string(argv[i]) == "--counters")
+			showcounters = 1;
+	}
+	// Soak input bypasses applyAction and the recorder, so a recording of it would not replay
+	if (soakhours > 0 && recordpath){
+		fprintf(stderr, "--soak cannot be combined with --record\n");
+		return 1;
+	}
 
-	GLFWwindow* window = initGLFW(width, height);
+	Replay replay;
+	size_t nextevent = 0;
+	if (replaypath){
+		if (!loadReplay(replaypath, replay))
+			return 1;
+		seed = replay.seed;
+	}
+	srand (seed);
+	initGame(game, seed);
+	if (replaypath)
+		game.inputlocked = 1;
+	if (recordpath && !startRecording(game, recordpath, seed))
+		return 1;
+	if (soakhours > 0)
+		return soak(soakhours);
+
+	// Offscreen there is no window: draw takes NULL, and nothing that needs one is called
+	GLFWwindow* window = NULL;
+	if (offscreenframes > 0){
+#ifdef OFFSCREEN
+		if (!initOffscreen(width, height))
+			return 1;
+#else
+		fprintf(stderr, "offscreen rendering needs a build with -DOFFSCREEN (make -f Makefile.linux sample2D_offscreen)\n");
+		return 1;
+#endif
+	}
+	else {
+		window = initGLFW(width, height);
+		if (replaypath)
+			glfwSwapInterval(0);
+	}
 
 	initGL (window, width, height);
+#ifdef PROFILE
+	initProfiler();
+#endif
+	if (capturepath){
+		// The window's framebuffer can be larger than the window on high DPI screens
+		int capturewidth = width, captureheight = height;
+		if (window)
+			glfwGetFramebufferSize(window, &capturewidth, &captureheight);
+		if (!startCapture(capturepath, capturewidth, captureheight))
+			return 1;
+	}
 
-	double last_update_time = glfwGetTime(), current_time;
-	last_beam_time = glfwGetTime();
-		/* Draw in loop */
-	int ind = 0;
-	char temp[10];
-	brickspeed = 1.0;
-	beamind = 0;
-	totalscore = 0;
-	life = 3;
-	gameover = 0;
 	zoomamount = 1.0;
 	dx = 0;
 	dy = 0;
-	srand (time(NULL));
-	while (!glfwWindowShouldClose(window)) {
-		draw(window);
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-		// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-		current_time = glfwGetTime(); // Time in seconds
-		if(current_time - last_beam_time >= 1.0){
-			gunparts["gunArm"].active = 0;
+
+	/* Draw in loop */
+	double previous_time = window ? glfwGetTime() : 0, current_time;
+	double accumulator = 0;
+	long frame = 0;
+	chrono::steady_clock::time_point offscreenstart = chrono::steady_clock::now();
+	while (window ? !glfwWindowShouldClose(window) : frame < offscreenframes) {
+		TRACE_SCOPE("frame");
+		// Run as many fixed ticks as the elapsed time covers, carrying the remainder to the next frame
+		current_time = window ? glfwGetTime() : 0; // Time in seconds
+		accumulator += current_time - previous_time;
+		previous_time = current_time;
+		if (accumulator > MAX_FRAME_TIME)
+			accumulator = MAX_FRAME_TIME;
+		{
+			PROFILE_SCOPE(STAGE_UPDATE);
+			if (!window){
+				// Offscreen frames are exactly one tick apart, so what they show does not depend on how fast they render
+				if (replaypath){
+					if (game.simticks >= replay.length)
+						break;
+					playReplayEvents(game, replay, nextevent, game.simticks);
+				}
+				update(game, TICK);
+				accumulator = TICK;
+			}
+			else if (replaypath){
+				// As many recorded ticks as fit in a frame's worth of time, then draw the latest state
+				double framestart = glfwGetTime();
+				while (game.simticks < replay.length && glfwGetTime() - framestart < TICK){
+					playReplayEvents(game, replay, nextevent, game.simticks);
+					update(game, TICK);
+				}
+				accumulator = TICK;
+				if (game.simticks >= replay.length)
+					glfwSetWindowShouldClose(window, 1);
+			}
+			else while (accumulator >= TICK){
+				update(game, TICK);
+				accumulator -= TICK;
+			}
+		}
+		{
+			PROFILE_SCOPE(STAGE_DRAW);
+#ifdef PROFILE
+			beginGpuTimer();
+#endif
+			draw(window, accumulator / TICK);
+#ifdef PROFILE
+			endGpuTimer();
+			drawProfileOverlay();
+#endif
+		}
+		captureFrame();
+#ifdef OFFSCREEN
+		if (!window && dumpdir && frame % dumpevery == 0){
+			char path[1024];
+			snprintf(path, sizeof(path), "%s/frame%06ld.ppm", dumpdir, frame);
+			if (!saveFrame(path, width, height)){
+				fprintf(stderr, "offscreen: cannot write %s\n", path);
+				break;
+			}
+		}
+#endif
+		frame ++;
+		if (!window){
+			PROFILE_END_FRAME();
+			continue;
 		}
-		current_time = glfwGetTime();
-		if ((current_time - last_update_time) >= (2.0 - brickspeed * 0.25)) { // atleast 0.5s elapsed since last frame
-		  	float xcoord = rand() % 500 - 210;
-		  	int newcolor = rand() % 10 + 1;
-		  	snprintf(temp, 10, "%d", ind);
-			string str (temp);
-		  	if(newcolor <= 4)
-				createRectangle ("brick" + str, red, 0.0, xcoord, 310.0, 20.0, 10.0, "bricks");
-			else if(newcolor <= 8)
-				createRectangle ("brick" + str, blue, 0.0, xcoord, 310.0, 20.0, 10.0, "bricks");
-			else 
-				createRectangle ("brick" + str, black, 0.0, xcoord, 310.0, 20.0, 10.0, "bricks");
-			last_update_time = current_time;
-			ind ++;
+		{
+			PROFILE_SCOPE(STAGE_SWAP);
+			glfwSwapBuffers(window);
 		}
+		{
+			PROFILE_SCOPE(STAGE_EVENTS);
+			glfwPollEvents();
+		}
+		PROFILE_END_FRAME();
+	}
+	stopCapture();
+	stopRecording(game);
+	cout << game.totalscore << endl;
+#ifdef PROFILE
+	traceDump("trace.json");
+#endif
+	if (!window){
+		glFinish();
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - offscreenstart).count();
+		fprintf(stderr, "offscreen: %ld frames in %.2fs, %.0f frames/s\n", frame, seconds, seconds > 0 ? frame / seconds : 0.0);
+#ifdef OFFSCREEN
+		closeOffscreen();
+#endif
+		return 0;
 	}
-	cout << totalscore << endl;
 	glfwTerminate();
 //    exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
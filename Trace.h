@@ -0,0 +1,151 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Trace events for offline profiling, written out in Chrome's JSON trace format (chrome://tracing, ui.perfetto.dev) */
+/* Only built with -DPROFILE - otherwise every TRACE_ macro expands to nothing */
+
+#ifdef PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+/* Events kept per thread - when a buffer wraps, the oldest events are overwritten */
+const int TRACE_EVENTS = 1 << 16;
+
+struct TraceEvent {
+	const char *name;	// must be a string literal, or otherwise outlive the trace
+	char phase;		// 'B' begin, 'E' end, 'X' complete, 'i' instant
+	long long ts;		// nanoseconds
+	long long dur;		// nanoseconds, complete events only
+};
+typedef struct TraceEvent TraceEvent;
+
+/* Only its own thread writes to a buffer, so recording takes no lock; count is published after each event so */
+/* traceDump can read the buffer from another thread - and since the slot written next is the oldest one once the */
+/* buffer has wrapped, traceDump checks count again after copying to drop any event overwritten under it */
+struct TraceBuffer {
+	TraceEvent events[TRACE_EVENTS];
+	std::atomic<unsigned long> count;
+	int tid;
+};
+typedef struct TraceBuffer TraceBuffer;
+
+/* Every thread's buffer, so they can all be dumped - only touched when a thread records its first event */
+struct TraceRegistry {
+	std::mutex lock;
+	std::vector<TraceBuffer*> buffers;
+};
+typedef struct TraceRegistry TraceRegistry;
+
+inline TraceRegistry &traceRegistry ()
+{
+	static TraceRegistry r;
+	return r;
+}
+
+inline long long traceNow ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline TraceBuffer &traceBuffer ()
+{
+	// Buffers are never freed, so a dump can still read the events of threads that have exited
+	static thread_local TraceBuffer *buf = NULL;
+	if (!buf){
+		buf = new TraceBuffer();
+		TraceRegistry &r = traceRegistry();
+		std::lock_guard<std::mutex> guard(r.lock);
+		buf->tid = r.buffers.size() + 1;
+		r.buffers.push_back(buf);
+	}
+	return *buf;
+}
+
+inline void traceEvent (const char *name, char phase, long long ts, long long dur)
+{
+	TraceBuffer &buf = traceBuffer();
+	unsigned long n = buf.count.load(std::memory_order_relaxed);
+	// Keep the writes to the slot after the store of count that made it the next one, so a dump that sees them sees that
+	std::atomic_thread_fence(std::memory_order_release);
+	TraceEvent &e = buf.events[n % TRACE_EVENTS];
+	e.name = name;
+	e.phase = phase;
+	e.ts = ts;
+	e.dur = dur;
+	buf.count.store(n + 1, std::memory_order_release);
+}
+
+/* Records the time from its construction to the end of its scope as one complete event */
+class TraceScope {
+public:
+	TraceScope (const char *name) : name(name), start(traceNow()) {}
+	~TraceScope () { traceEvent(name, 'X', start, traceNow() - start); }
+private:
+	const char *name;
+	long long start;
+};
+
+/* Write every thread's recorded events to path, returning 0 if it cannot be written */
+/* Events a thread records while the dump runs may or may not be included, but none is written half recorded */
+inline int traceDump (const char *path)
+{
+	FILE *out = fopen(path, "w");
+	if (!out)
+		return 0;
+	fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	int first = 1;
+	TraceRegistry &r = traceRegistry();
+	std::lock_guard<std::mutex> guard(r.lock);
+	for (size_t b = 0; b < r.buffers.size(); b++){
+		TraceBuffer &buf = *r.buffers[b];
+		// The slot of event n is being overwritten if the thread is recording, so leave out the event it held
+		unsigned long n = buf.count.load(std::memory_order_acquire);
+		unsigned long oldest = n >= (unsigned long) TRACE_EVENTS ? n + 1 - TRACE_EVENTS : 0;
+		unsigned long copied = oldest;
+		std::vector<TraceEvent> events;
+		for (unsigned long i = oldest; i < n; i++)
+			events.push_back(buf.events[i % TRACE_EVENTS]);
+		// Events recorded during the copy may have overwritten the oldest ones copied - skip as many as could have
+		std::atomic_thread_fence(std::memory_order_acquire);
+		unsigned long now = buf.count.load(std::memory_order_relaxed);
+		if (now >= oldest + TRACE_EVENTS)
+			oldest = now + 1 - TRACE_EVENTS;
+		for (unsigned long i = oldest; i < n; i++){
+			TraceEvent &e = events[i - copied];
+			// Chrome expects microseconds
+			fprintf(out, "%s{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d",
+				first ? "" : ",\n", e.name, e.phase, e.ts / 1000.0, buf.tid);
+			if (e.phase == 'X')
+				fprintf(out, ", \"dur\": %.3f", e.dur / 1000.0);
+			else if (e.phase == 'i')
+				fprintf(out, ", \"s\": \"t\"");
+			fprintf(out, "}");
+			first = 0;
+		}
+	}
+	fprintf(out, "\n]}\n");
+	fclose(out);
+	return 1;
+}
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(tracescope, __LINE__)(name)
+#define TRACE_BEGIN(name) traceEvent(name, 'B', traceNow(), 0)
+#define TRACE_END(name) traceEvent(name, 'E', traceNow(), 0)
+#define TRACE_INSTANT(name) traceEvent(name, 'i', traceNow(), 0)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_BEGIN(name)
+#define TRACE_END(name)
+#define TRACE_INSTANT(name)
+
+#endif
+
+#endif